@@ -0,0 +1,56 @@
+//
+//  Arena.cpp
+//
+
+#include "Arena.hpp"
+
+#include <stdlib.h>
+#include <stdint.h>
+
+Arena::Arena(size_t blockSize) {
+    this->blockSize = blockSize;
+    this->cursor = NULL;
+    this->limit = NULL;
+    this->bytesUsed = 0;
+}
+
+void Arena::grow(size_t minSize) {
+    // the rest of the current block is abandoned, a large request gets a block of its own size
+    size_t size = minSize > blockSize ? minSize : blockSize;
+    char* block = (char*) malloc(size);
+    if (!block) throw bad_alloc();
+    blocks.push_back(block);
+    cursor = block;
+    limit = block + size;
+}
+
+void Arena::reserve(size_t bytes) {
+    if ((size_t) (limit - cursor) < bytes) {
+        grow(bytes);
+    }
+}
+
+void* Arena::allocate(size_t size, size_t align) {
+    uintptr_t address = ((uintptr_t) cursor + align - 1) & ~(uintptr_t) (align - 1);
+    if (!cursor || address + size > (uintptr_t) limit) {
+        grow(size + align);
+        address = ((uintptr_t) cursor + align - 1) & ~(uintptr_t) (align - 1);
+    }
+    cursor = (char*) (address + size);
+    bytesUsed += size;
+    return (void*) address;
+}
+
+void Arena::release() {
+    for (char* block : blocks) {
+        free(block);
+    }
+    blocks.clear();
+    cursor = NULL;
+    limit = NULL;
+    bytesUsed = 0;
+}
+
+Arena::~Arena() {
+    release();
+}
@@ -0,0 +1,59 @@
+//
+//  Arena.hpp
+//
+
+#ifndef Arena_hpp
+#define Arena_hpp
+
+#include <stdio.h>
+#include <stddef.h>
+#include <new>
+#include <utility>
+#include <vector>
+
+#define ARENA_BLOCK     (1 << 20)   // default bytes per block
+
+using namespace std;
+
+// Bump allocator for objects that live exactly as long as their owner.
+// Objects are never destroyed one by one: release() frees every block at
+// once without running destructors, so only types whose destructors do
+// nothing (Particle, SpringDamper, Triangle) may be created here.
+class Arena {
+private:
+    vector<char*> blocks;
+    char* cursor;       // next free byte of the current block
+    char* limit;        // end of the current block
+    size_t blockSize;
+    size_t bytesUsed;
+
+    void grow(size_t minSize);
+
+public:
+    Arena(size_t blockSize = ARENA_BLOCK);
+
+    Arena(const Arena&) = delete;
+
+    Arena& operator=(const Arena&) = delete;
+
+    // make sure the next bytes fit into a single block
+    void reserve(size_t bytes);
+
+    void* allocate(size_t size, size_t align);
+
+    template <typename T, typename... Args>
+    T* create(Args&&... args) {
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    // free everything at once
+    void release();
+
+    size_t getBytesUsed() { return bytesUsed; }
+
+    size_t getBlockCount() { return blocks.size(); }
+
+    ~Arena();
+};
+
+#endif /* Arena_hpp */
@@ -0,0 +1,233 @@
+//
+//  Checkpoint.cpp
+//
+
+#include "Checkpoint.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <errno.h>
+#include <string.h>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+
+static uint64_t alignUp(uint64_t size) {
+    return (size + CHECKPOINT_ALIGN - 1) & ~(uint64_t) (CHECKPOINT_ALIGN - 1);
+}
+
+bool Checkpoint::save(Cloth* cloth, const char* path) {
+    CheckpointHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = CHECKPOINT_MAGIC;
+    header.version = CHECKPOINT_VERSION;
+    header.width = cloth->width;
+    header.height = cloth->height;
+    header.numParticles = (uint32_t) cloth->particles.size();
+    header.numSprings = (uint32_t) cloth->springDampers.size();
+    header.numTriangles = (uint32_t) cloth->triangles.size();
+    header.numFixed = (uint32_t) cloth->fixedId.size();
+    header.offset = cloth->offset;
+    header.totalMass = cloth->totalMass;
+    memcpy(header.wind, &cloth->wind[0], sizeof(header.wind));
+    memcpy(header.color, &cloth->color[0], sizeof(header.color));
+    header.gridStencil = cloth->gridStencil;
+    header.bendStride = cloth->bendStride;
+    header.Ks = cloth->Ks;
+    header.Kd = cloth->Kd;
+    header.bendKs = cloth->bendKs;
+
+    // lay out the sections
+    uint64_t n = header.numParticles;
+    header.positionsOffset = alignUp(sizeof(CheckpointHeader));
+    header.velocitiesOffset = alignUp(header.positionsOffset + n * sizeof(glm::vec3));
+    header.massesOffset = alignUp(header.velocitiesOffset + n * sizeof(glm::vec3));
+    header.springsOffset = alignUp(header.massesOffset + n * sizeof(float));
+    header.trianglesOffset = alignUp(header.springsOffset + header.numSprings * sizeof(CheckpointSpring));
+    header.fixedOffset = alignUp(header.trianglesOffset + header.numTriangles * 3 * sizeof(uint32_t));
+    header.originalIdsOffset = alignUp(header.fixedOffset + header.numFixed * sizeof(uint32_t));
+    header.fileSize = alignUp(header.originalIdsOffset + n * sizeof(uint32_t));
+
+    vector<char> buffer(header.fileSize, 0);
+    char* base = buffer.data();
+    memcpy(base, &header, sizeof(header));
+
+    glm::vec3* positions = (glm::vec3*) (base + header.positionsOffset);
+    glm::vec3* velocities = (glm::vec3*) (base + header.velocitiesOffset);
+    float* masses = (float*) (base + header.massesOffset);
+    unordered_map<const Particle*, uint32_t> particleId(n);
+    for (uint32_t i = 0; i < n; i++) {
+        Particle* particle = cloth->particles[i];
+        positions[i] = particle->p;
+        velocities[i] = particle->v;
+        masses[i] = particle->m;
+        particleId[particle] = i;
+    }
+
+    CheckpointSpring* springs = (CheckpointSpring*) (base + header.springsOffset);
+    for (uint32_t i = 0; i < header.numSprings; i++) {
+        SpringDamper* s = cloth->springDampers[i];
+        springs[i] = {particleId[s->p1], particleId[s->p2], s->l, s->Ks, s->Kd, s->stretch ? 1u : 0u};
+    }
+
+    uint32_t* triangles = (uint32_t*) (base + header.trianglesOffset);
+    for (uint32_t i = 0; i < header.numTriangles; i++) {
+        Triangle* t = cloth->triangles[i];
+        triangles[3 * i] = particleId[t->a];
+        triangles[3 * i + 1] = particleId[t->b];
+        triangles[3 * i + 2] = particleId[t->c];
+    }
+
+    memcpy(base + header.fixedOffset, cloth->fixedId.data(), header.numFixed * sizeof(uint32_t));
+    memcpy(base + header.originalIdsOffset, cloth->originalId.data(), n * sizeof(uint32_t));
+
+    // write next to the destination and rename, so a crash never leaves a torn snapshot
+    string tmpPath = string(path) + ".tmp";
+    int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        cerr << "Failed to create checkpoint " << tmpPath << ": " << strerror(errno) << endl;
+        return false;
+    }
+    size_t written = 0;
+    while (written < buffer.size()) {
+        ssize_t result = write(fd, base + written, buffer.size() - written);
+        if (result < 0 && errno == EINTR) continue;
+        if (result <= 0) {
+            cerr << "Failed to write checkpoint " << tmpPath << ": " << strerror(errno) << endl;
+            close(fd);
+            unlink(tmpPath.c_str());
+            return false;
+        }
+        written += result;
+    }
+    close(fd);
+
+    if (rename(tmpPath.c_str(), path) != 0) {
+        cerr << "Failed to move checkpoint to " << path << ": " << strerror(errno) << endl;
+        unlink(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+Cloth* Checkpoint::load(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        cerr << "Failed to open checkpoint " << path << ": " << strerror(errno) << endl;
+        return NULL;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t) info.st_size < sizeof(CheckpointHeader)) {
+        cerr << "Checkpoint " << path << " is too small" << endl;
+        close(fd);
+        return NULL;
+    }
+    size_t fileSize = info.st_size;
+    void* mapping = mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        cerr << "Failed to map checkpoint " << path << ": " << strerror(errno) << endl;
+        return NULL;
+    }
+
+    const char* base = (const char*) mapping;
+    const CheckpointHeader& header = *(const CheckpointHeader*) base;
+    uint64_t n = header.numParticles;
+    bool valid = header.magic == CHECKPOINT_MAGIC
+        && header.version == CHECKPOINT_VERSION
+        && header.fileSize == fileSize
+        && header.positionsOffset + n * sizeof(glm::vec3) <= fileSize
+        && header.velocitiesOffset + n * sizeof(glm::vec3) <= fileSize
+        && header.massesOffset + n * sizeof(float) <= fileSize
+        && header.springsOffset + header.numSprings * sizeof(CheckpointSpring) <= fileSize
+        && header.trianglesOffset + header.numTriangles * 3 * sizeof(uint32_t) <= fileSize
+        && header.fixedOffset + header.numFixed * sizeof(uint32_t) <= fileSize
+        && header.originalIdsOffset + n * sizeof(uint32_t) <= fileSize
+        && (!header.gridStencil || (uint64_t) header.width * header.height == n);
+    if (!valid) {
+        cerr << "Checkpoint " << path << " is corrupt or from another version" << endl;
+        munmap(mapping, fileSize);
+        return NULL;
+    }
+
+    const glm::vec3* positions = (const glm::vec3*) (base + header.positionsOffset);
+    const glm::vec3* velocities = (const glm::vec3*) (base + header.velocitiesOffset);
+    const float* masses = (const float*) (base + header.massesOffset);
+    const CheckpointSpring* springs = (const CheckpointSpring*) (base + header.springsOffset);
+    const uint32_t* triangles = (const uint32_t*) (base + header.trianglesOffset);
+    const uint32_t* fixed = (const uint32_t*) (base + header.fixedOffset);
+    const uint32_t* originalIds = (const uint32_t*) (base + header.originalIdsOffset);
+
+    // every index has to reference a particle before anything is built
+    for (uint32_t i = 0; i < header.numSprings && valid; i++) {
+        valid = springs[i].p1 < n && springs[i].p2 < n;
+    }
+    for (uint64_t i = 0; i < 3 * (uint64_t) header.numTriangles && valid; i++) {
+        valid = triangles[i] < n;
+    }
+    for (uint32_t i = 0; i < header.numFixed && valid; i++) {
+        valid = fixed[i] < n;
+    }
+    for (uint32_t i = 0; i < n && valid; i++) {
+        valid = originalIds[i] < n;
+    }
+    if (!valid) {
+        cerr << "Checkpoint " << path << " references missing particles" << endl;
+        munmap(mapping, fileSize);
+        return NULL;
+    }
+
+    Cloth* cloth = new Cloth();
+    cloth->width = header.width;
+    cloth->height = header.height;
+    cloth->offset = header.offset;
+    cloth->totalMass = header.totalMass;
+    cloth->wind = glm::vec3(header.wind[0], header.wind[1], header.wind[2]);
+    cloth->color = glm::vec3(header.color[0], header.color[1], header.color[2]);
+    cloth->terrain = NULL;
+    cloth->model = glm::mat4(1.0f);
+    cloth->gridStencil = header.gridStencil != 0;
+    cloth->bendStride = header.bendStride;
+    cloth->Ks = header.Ks;
+    cloth->Kd = header.Kd;
+    cloth->bendKs = header.bendKs;
+    if (cloth->gridStencil) {
+        cloth->initGridArrays();
+    }
+
+    cloth->positions.assign(positions, positions + n);
+    cloth->normals = vector<glm::vec3>(n);
+
+    cloth->reserveTopology(n, header.numSprings, header.numTriangles);
+    for (uint32_t i = 0; i < n; i++) {
+        Particle* particle = cloth->arena.create<Particle>(positions[i].x, positions[i].y, positions[i].z, masses[i]);
+        particle->v = velocities[i];
+        cloth->particles.push_back(particle);
+    }
+
+    for (uint32_t i = 0; i < header.numSprings; i++) {
+        const CheckpointSpring& s = springs[i];
+        cloth->springDampers.push_back(cloth->arena.create<SpringDamper>(cloth->particles[s.p1], cloth->particles[s.p2], s.l, s.Ks, s.Kd, s.stretch != 0));
+    }
+
+    cloth->indices.assign(triangles, triangles + 3 * (uint64_t) header.numTriangles);
+    for (uint32_t i = 0; i < header.numTriangles; i++) {
+        const uint32_t* t = triangles + 3 * i;
+        cloth->triangles.push_back(cloth->arena.create<Triangle>(cloth->particles[t[0]], cloth->particles[t[1]], cloth->particles[t[2]]));
+    }
+
+    cloth->fixedId.assign(fixed, fixed + header.numFixed);
+    cloth->originalId.assign(originalIds, originalIds + n);
+    cloth->updateCurrentIds();
+    cloth->getOriginalPositions(cloth->restPositions); // reset goes back to the snapshot
+    for (unsigned int id : cloth->fixedId) {
+        cloth->particles[id]->fixed = true;
+    }
+
+    munmap(mapping, fileSize);
+
+    cloth->updateNormals();
+    return cloth;
+}
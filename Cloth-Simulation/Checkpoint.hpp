@@ -0,0 +1,69 @@
+//
+//  Checkpoint.hpp
+//
+
+#ifndef Checkpoint_hpp
+#define Checkpoint_hpp
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "Cloth.hpp"
+
+#define CHECKPOINT_MAGIC    0x4b434c43u // "CLCK" in little endian
+#define CHECKPOINT_VERSION  4u
+#define CHECKPOINT_ALIGN    16
+
+// On-disk layout: the header is followed by the sections it points at, each
+// aligned to CHECKPOINT_ALIGN bytes so they can be read in place from a mapping.
+struct CheckpointHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t fileSize;
+
+    uint32_t width;
+    uint32_t height;
+    uint32_t numParticles;
+    uint32_t numSprings;
+    uint32_t numTriangles;
+    uint32_t numFixed;
+
+    float offset;
+    float totalMass;
+    float wind[3];
+    float color[3];
+
+    uint32_t gridStencil;   // springs come from the grid stencil, numSprings is 0
+    uint32_t bendStride;
+    float Ks;
+    float Kd;
+    float bendKs;
+
+    uint64_t positionsOffset;   // glm::vec3[numParticles]
+    uint64_t velocitiesOffset;  // glm::vec3[numParticles]
+    uint64_t massesOffset;      // float[numParticles]
+    uint64_t springsOffset;     // CheckpointSpring[numSprings]
+    uint64_t trianglesOffset;   // uint32_t[3 * numTriangles]
+    uint64_t fixedOffset;       // uint32_t[numFixed]
+    uint64_t originalIdsOffset; // uint32_t[numParticles], build order of each particle
+};
+
+struct CheckpointSpring {
+    uint32_t p1;
+    uint32_t p2;
+    float l;    // rest length
+    float Ks;   // spring constant
+    float Kd;   // damping factor
+    uint32_t stretch;   // 1 for structural and shear springs, 0 for bend springs
+};
+
+class Checkpoint {
+public:
+    // write the full simulation state of the cloth with a single write, false on failure
+    static bool save(Cloth* cloth, const char* path);
+
+    // map a snapshot written by save and rebuild the cloth from it, NULL on failure
+    static Cloth* load(const char* path);
+};
+
+#endif /* Checkpoint_hpp */
@@ -6,11 +6,21 @@
 //
 
 #include "Cloth.hpp"
+#include "Profiler.hpp"
+#include "Parallel.hpp"
 
-Cloth::Cloth() {}
+#include <algorithm>
+#include <unordered_map>
+#include <iostream>
+#include <stdint.h>
+#include <float.h>
+
+Cloth::Cloth() : VAO(0), uploadedBytes(0), previousKept(false), blend(1.0f), ordering(REORDER_NONE), windField(NULL), windTime(0.0f),
+                 gridStencil(false), tiled(false), sleeping(false), multirate(false),
+                 strainLimit(0.0f), projective(NULL), remesher(NULL) {}
 
 Cloth::Cloth(unsigned int height, unsigned int width, float offset,
-             float totalMass, glm::vec3 color, bool verticalLayOut) {
+             float totalMass, glm::vec3 color, bool verticalLayOut, bool gridStencil) {
     
     this->height = height;
     this->width = width;
@@ -18,18 +28,72 @@ Cloth::Cloth(unsigned int height, unsigned int width, float offset,
     this->color = color;
     this->totalMass = totalMass;
     this->wind = glm::vec3(0.0f, 0.0f, 0.0f);
-    this->groundHeight = -2.5f; // default height of the ground
+    this->terrain = NULL;
+    this->windField = NULL;
+    this->windTime = 0.0f;
+    this->gridStencil = gridStencil;
+    this->tiled = false;
+    this->sleeping = false;
+    this->multirate = false;
+    this->strainLimit = 0.0f;
+    this->projective = NULL;
+    this->remesher = NULL;
+    this->ordering = REORDER_NONE;
+    this->VAO = 0; // GPU buffers are created on the first upload, building needs no GL context
+    this->uploadedBytes = 0;
+    this->previousKept = false;
+    this->blend = 1.0f;
+    this->Ks = SPRING_CONST;
+    this->Kd = DAMPING_CONST;
+    this->bendStride = BEND_STRIDE;
+    this->bendKs = BEND_CONST;
     
     positions = vector<glm::vec3>(width * height);
     normals = vector<glm::vec3>(width * height);
     
     model = glm::mat4(1.0f); // local matrix
     
+    size_t springCount = 0;
+    if (!gridStencil) {
+        springCount = gridSpringCount(1);
+        if (bendKs > 0.0f) springCount += gridSpringCount(bendStride);
+    }
+    reserveTopology(width * height, springCount, 2 * (size_t) (width - 1) * (height - 1));
+    
     initParticles(verticalLayOut);
-    initSpringDampers(1, SPRING_CONST, DAMPING_CONST);
+    originalId = vector<unsigned int>(width * height);
+    for (unsigned int i = 0; i < originalId.size(); i++) {
+        originalId[i] = i;
+    }
+    restPositions = positions;
+    if (gridStencil) { // every rest length follows from the grid, nothing is stored per spring
+        initGridArrays();
+    }
+    else {
+        initSpringDampers(1, Ks, Kd, true);
+        if (bendKs > 0.0f) {
+            initSpringDampers(bendStride, bendKs, Kd, false);
+        }
+    }
     initTriangles();
     updateNormals();
-    initBuffers();
+}
+
+// springs initSpringDampers makes for one span: up and right where they fit, two diagonals per square
+size_t Cloth::gridSpringCount(unsigned int span) {
+    size_t up = height > span ? height - span : 0;
+    size_t right = width > span ? width - span : 0;
+    return up * width + right * height + 2 * up * right;
+}
+
+void Cloth::reserveTopology(size_t particleCount, size_t springCount, size_t triangleCount) {
+    // alignment slack for each of the three kinds of object
+    arena.reserve(particleCount * sizeof(Particle) + springCount * sizeof(SpringDamper)
+                  + triangleCount * sizeof(Triangle) + 3 * alignof(max_align_t));
+    particles.reserve(particleCount);
+    springDampers.reserve(springCount);
+    triangles.reserve(triangleCount);
+    indices.reserve(3 * triangleCount);
 }
 
 void Cloth::initParticles(bool verticalLayout) {
@@ -40,7 +104,7 @@ void Cloth::initParticles(bool verticalLayout) {
     if (verticalLayout) {
         for (unsigned int h = 0; h < height; h++) {
             for (unsigned int w = 0; w < width; w++) {
-                Particle* particle = new Particle(offset * (w - halfWidth), offset * (h - halfHeight), 0.0f, mass);
+                Particle* particle = arena.create<Particle>(offset * (w - halfWidth), offset * (h - halfHeight), 0.0f, mass);
                 positions[particles.size()] = particle->p;
                 particles.push_back(particle);
             }
@@ -49,7 +113,7 @@ void Cloth::initParticles(bool verticalLayout) {
     else {
         for (unsigned int h = 0; h < height; h++) {
             for (unsigned int w = 0; w < width; w++) {
-                Particle* particle = new Particle(offset * (w - halfWidth), 0.0f, -offset * (h - halfHeight), mass);
+                Particle* particle = arena.create<Particle>(offset * (w - halfWidth), 0.0f, -offset * (h - halfHeight), mass);
                 positions[particles.size()] = particle->p;
                 particles.push_back(particle);
             }
@@ -57,39 +121,53 @@ void Cloth::initParticles(bool verticalLayout) {
     }
 }
 
-void Cloth::initSpringDampers(unsigned int numBetween, float Ks, float Kd) {
+void Cloth::initSpringDampers(unsigned int numBetween, float Ks, float Kd, bool stretch) {
     float len = numBetween * this->offset;
     float diagLen = sqrt(2) * len;
-    for (unsigned int h = 0; h < height; h += numBetween) {
+    unsigned int rowSpan = numBetween * width;
+    for (unsigned int h = 0; h < height; h++) {
         unsigned int rowOffset = h * width;
-        for (unsigned int w = 0; w < width; w += numBetween) {
-            // not at top most col
-            if (h < height - numBetween) {
+        for (unsigned int w = 0; w < width; w++) {
+            // not at top most rows
+            if (h + numBetween < height) {
                 // always have up: connect curr -> up
                 Particle* curr = particles[rowOffset + w];
-                Particle* up = particles[rowOffset + width + w];
-                springDampers.push_back(new SpringDamper(curr, up, len, Ks, Kd));
+                Particle* up = particles[rowOffset + rowSpan + w];
+                springDampers.push_back(arena.create<SpringDamper>(curr, up, len, Ks, Kd, stretch));
                 
-                // not at last row: connect curr -> right, up -> right, curr -> upright
-                if (w < width - numBetween) {
+                // not at last cols: connect curr -> right, up -> right, curr -> upright
+                if (w + numBetween < width) {
                     Particle* right = particles[rowOffset + w + numBetween];
-                    Particle* upRight = particles[rowOffset + width + w + numBetween];
-                    springDampers.push_back(new SpringDamper(curr, right, len, Ks, Kd));
-                    springDampers.push_back(new SpringDamper(up, right, diagLen, Ks, Kd));
-                    springDampers.push_back(new SpringDamper(curr, upRight, diagLen, Ks, Kd));
+                    Particle* upRight = particles[rowOffset + rowSpan + w + numBetween];
+                    springDampers.push_back(arena.create<SpringDamper>(curr, right, len, Ks, Kd, stretch));
+                    springDampers.push_back(arena.create<SpringDamper>(up, right, diagLen, Ks, Kd, stretch));
+                    springDampers.push_back(arena.create<SpringDamper>(curr, upRight, diagLen, Ks, Kd, stretch));
                 }
             }
-            else { // at top most col: only connect curr -> right
-                if (w < width - numBetween) {
+            else { // at top most rows: only connect curr -> right
+                if (w + numBetween < width) {
                     Particle* curr = particles[rowOffset + w];
                     Particle* right = particles[rowOffset + w + numBetween];
-                    springDampers.push_back(new SpringDamper(curr, right, len, Ks, Kd));
+                    springDampers.push_back(arena.create<SpringDamper>(curr, right, len, Ks, Kd, stretch));
                 }
             }
         }
     }
 }
 
+void Cloth::initGridArrays() {
+    gridP.resize(width * height);
+    gridV.resize(width * height);
+    gridF.resize(width * height);
+    for (unsigned int d = 0; d < GRID_DIRECTIONS; d++) {
+        gridEdges[d].resize(width * height);
+    }
+    nextP.resize(width * height);
+    nextV.resize(width * height);
+    gridM.assign(width * height, 0.0f);
+    gridFixed.assign(width * height, 0);
+}
+
 void Cloth::initTriangles() {
     for (unsigned int h = 0; h < height - 1; h++) {
          unsigned int rowOffset = h * width;
@@ -98,14 +176,703 @@ void Cloth::initTriangles() {
             unsigned int rightId = rowOffset + w + 1;
             unsigned int upId = rowOffset + width + w;
             unsigned int upRightId = rowOffset + width + w + 1;
-            triangles.push_back(new Triangle(particles[currId], particles[upRightId], particles[upId]));
-            triangles.push_back(new Triangle(particles[currId], particles[rightId], particles[upRightId]));
+            triangles.push_back(arena.create<Triangle>(particles[currId], particles[upRightId], particles[upId]));
+            triangles.push_back(arena.create<Triangle>(particles[currId], particles[rightId], particles[upRightId]));
             indices.insert(indices.end(), {currId, upRightId, upId});
             indices.insert(indices.end(), {currId, rightId, upRightId});
         }
     }
 }
 
+// forward neighbours of the stencil (right, up, up-right, up-left), the other four are their reverses
+static const int stencilW[GRID_DIRECTIONS] = {1, 0, 1, -1};
+static const int stencilH[GRID_DIRECTIONS] = {0, 1, 1, 1};
+
+void Cloth::applyGridForces() {
+    // gather into row-major arrays so every neighbour is a fixed index offset away
+    for (unsigned int i = 0; i < particles.size(); i++) {
+        gridP.x[i] = particles[i]->p.x;
+        gridP.y[i] = particles[i]->p.y;
+        gridP.z[i] = particles[i]->p.z;
+        gridV.x[i] = particles[i]->v.x;
+        gridV.y[i] = particles[i]->v.y;
+        gridV.z[i] = particles[i]->v.z;
+    }
+    
+    // both sweeps write whole rows, so rows can go to different threads
+    size_t rowGrain = glm::max(1u, PARALLEL_GRAIN / width);
+    unsigned int numSpans = bendKs > 0.0f ? 2 : 1;
+    for (unsigned int span = 0; span < numSpans; span++) {
+        Parallel::forRange(height, rowGrain, [this, span](size_t begin, size_t end) {
+            computeGridEdges(gridP, gridV, gridEdges, width, height, (unsigned int) begin, (unsigned int) end, span);
+        });
+        Parallel::forRange(height, rowGrain, [this, span](size_t begin, size_t end) {
+            gatherGridEdges(gridEdges, gridF, width, (unsigned int) begin, (unsigned int) end, span);
+        });
+    }
+    
+    for (unsigned int i = 0; i < particles.size(); i++) {
+        particles[i]->f += glm::vec3(gridF.x[i], gridF.y[i], gridF.z[i]);
+    }
+}
+
+void Cloth::computeGridEdges(const GridField& p, const GridField& v, GridField* edges,
+                             unsigned int cols, unsigned int rows,
+                             unsigned int rowBegin, unsigned int rowEnd, unsigned int span) {
+    // structural and shear springs span one particle, bend springs bendStride
+    int stride = span == 0 ? 1 : (int) bendStride;
+    float k = span == 0 ? Ks : bendKs;
+    float len = stride * offset;
+    float diagLen = sqrt(2) * len;
+    
+    const float* __restrict px = p.x.data();
+    const float* __restrict py = p.y.data();
+    const float* __restrict pz = p.z.data();
+    const float* __restrict vx = v.x.data();
+    const float* __restrict vy = v.y.data();
+    const float* __restrict vz = v.z.data();
+    
+    // one force per edge, stored at its first particle; edges leaving the grid get none
+    for (unsigned int d = 0; d < GRID_DIRECTIONS; d++) {
+        int dw = stride * stencilW[d];
+        int dh = stride * stencilH[d];
+        int next = dh * (int) cols + dw;
+        unsigned int wBegin = glm::min(cols, (unsigned int) glm::max(0, -dw));
+        unsigned int wEnd = glm::max(wBegin, (unsigned int) glm::max(0, (int) cols - glm::max(0, dw)));
+        float l = stencilW[d] != 0 && stencilH[d] != 0 ? diagLen : len;
+        float* __restrict ex = edges[d].x.data();
+        float* __restrict ey = edges[d].y.data();
+        float* __restrict ez = edges[d].z.data();
+        
+        for (unsigned int h = rowBegin; h < rowEnd; h++) {
+            unsigned int rowOffset = h * cols;
+            unsigned int begin = h + dh < rows ? rowOffset + wBegin : rowOffset + cols;
+            unsigned int end = h + dh < rows ? rowOffset + wEnd : rowOffset + cols;
+            for (unsigned int i = rowOffset; i < begin; i++) {
+                ex[i] = ey[i] = ez[i] = 0.0f;
+            }
+            for (unsigned int i = end; i < rowOffset + cols; i++) {
+                ex[i] = ey[i] = ez[i] = 0.0f;
+            }
+            
+            // the same expression SpringDamper::applyForce evaluates for its first particle
+            for (unsigned int i = begin; i < end; i++) {
+                float x = px[i + next] - px[i];
+                float y = py[i + next] - py[i];
+                float z = pz[i + next] - pz[i];
+                float eLen = sqrt(x * x + y * y + z * z);
+                float inv = 1.0f / eLen;
+                x *= inv;
+                y *= inv;
+                z *= inv;
+                float fspring = -k * (l - eLen);
+                float fdamp = -Kd * ((vx[i] - vx[i + next]) * x + (vy[i] - vy[i + next]) * y + (vz[i] - vz[i + next]) * z);
+                float f = fspring + fdamp;
+                ex[i] = f * x;
+                ey[i] = f * y;
+                ez[i] = f * z;
+            }
+        }
+    }
+}
+
+void Cloth::gatherGridEdges(const GridField* edges, GridField& f, unsigned int cols,
+                            unsigned int rowBegin, unsigned int rowEnd, unsigned int span) {
+    int stride = span == 0 ? 1 : (int) bendStride;
+    float* __restrict fx = f.x.data();
+    float* __restrict fy = f.y.data();
+    float* __restrict fz = f.z.data();
+    
+    for (unsigned int h = rowBegin; h < rowEnd; h++) {
+        unsigned int rowOffset = h * cols;
+        
+        // the first span starts the sums, the bend span adds to them
+        if (span == 0) {
+            for (unsigned int i = rowOffset; i < rowOffset + cols; i++) {
+                fx[i] = fy[i] = fz[i] = 0.0f;
+            }
+        }
+        
+        // each particle pulls on the edges it starts and pushes on the edges it ends
+        for (unsigned int d = 0; d < GRID_DIRECTIONS; d++) {
+            const float* __restrict ex = edges[d].x.data();
+            const float* __restrict ey = edges[d].y.data();
+            const float* __restrict ez = edges[d].z.data();
+            for (unsigned int i = rowOffset; i < rowOffset + cols; i++) {
+                fx[i] += ex[i];
+                fy[i] += ey[i];
+                fz[i] += ez[i];
+            }
+            
+            int dw = stride * stencilW[d];
+            int dh = stride * stencilH[d];
+            if ((int) h < dh) continue;
+            int prev = dh * (int) cols + dw;
+            unsigned int begin = rowOffset + glm::min(cols, (unsigned int) glm::max(0, dw));
+            unsigned int end = glm::max(begin, rowOffset + (unsigned int) glm::max(0, (int) cols + glm::min(0, dw)));
+            for (unsigned int i = begin; i < end; i++) {
+                fx[i] -= ex[i - prev];
+                fy[i] -= ey[i - prev];
+                fz[i] -= ez[i - prev];
+            }
+        }
+    }
+}
+
+void Cloth::updateTiled() {
+    // gather the whole cloth once per frame
+    for (unsigned int i = 0; i < particles.size(); i++) {
+        gridP.x[i] = particles[i]->p.x;
+        gridP.y[i] = particles[i]->p.y;
+        gridP.z[i] = particles[i]->p.z;
+        gridV.x[i] = particles[i]->v.x;
+        gridV.y[i] = particles[i]->v.y;
+        gridV.z[i] = particles[i]->v.z;
+        gridM[i] = particles[i]->m;
+        gridFixed[i] = particles[i]->fixed;
+    }
+    
+    // tiles read the old state around them and write the new one into separate arrays
+    unsigned int tileRows = (height + TILE_SIZE - 1) / TILE_SIZE;
+    unsigned int tileCols = (width + TILE_SIZE - 1) / TILE_SIZE;
+    if (sleeping) {
+        if (tileAsleep.size() != tileRows * tileCols) {
+            tileAsleep.assign(tileRows * tileCols, 0);
+            tileCalmFrames.assign(tileRows * tileCols, 0);
+        }
+        tileCalm.assign(tileRows * tileCols, 1);
+    }
+    
+    // the strain limit carries moves across the whole cloth within a substep, far past the reach of the forces;
+    // with it the tiles take one substep per pass, and the limit and the collisions after it run on the whole grid
+    unsigned int passSubsteps = strainLimit > 0.0f ? 1 : TILE_SUBSTEPS;
+    tileLevel.assign(tileRows * tileCols, 0);
+    if (multirate) {
+        assignTileLevels(tileRows, tileCols, glm::min(passSubsteps, (unsigned int) NUM_SAMPLE));
+    }
+    
+    // a range of tiles reuses its working set, so the arrays are only allocated when the tiles or threads change
+    size_t tileCount = tileRows * tileCols;
+    if (tileScratch.size() < Parallel::chunkCount(tileCount, 1)) {
+        tileScratch.resize(Parallel::chunkCount(tileCount, 1));
+    }
+    for (unsigned int done = 0; done < NUM_SAMPLE; done += passSubsteps) {
+        unsigned int substeps = glm::min(passSubsteps, NUM_SAMPLE - done);
+        Parallel::forChunks(tileCount, 1, [this, tileCols, substeps](size_t chunk, size_t begin, size_t end) {
+            GridTile& tile = tileScratch[chunk];
+            for (size_t t = begin; t < end; t++) {
+                unsigned int tileRow = (unsigned int) t / tileCols, tileCol = (unsigned int) t % tileCols;
+                if (sleeping && tileAsleep[t]) {
+                    holdTile(tileRow, tileCol);
+                    continue;
+                }
+                // a shorter last pass may not divide into the steps of the level
+                unsigned int level = tileLevel[t];
+                while (substeps % (1u << level) != 0) level--;
+                bool calm = updateTile(tile, tileRow, tileCol, substeps, level);
+                if (sleeping) tileCalm[t] = tileCalm[t] && calm;
+            }
+        });
+        swap(gridP, nextP);
+        swap(gridV, nextV);
+        
+        if (strainLimit > 0.0f) {
+            limitGridStrain(gridP, gridV, gridM.data(), gridFixed.data(), width, height, TIME_STEP);
+            if (terrain) {
+                terrain->handleCollision(gridP.x.data(), gridP.y.data(), gridP.z.data(),
+                                         gridV.x.data(), gridV.y.data(), gridV.z.data(),
+                                         (unsigned int) particles.size(), ELASTICITY, FRICTION, EPSILON);
+            }
+        }
+    }
+    if (sleeping) {
+        settleTiles(tileRows, tileCols);
+    }
+    
+    for (unsigned int i = 0; i < particles.size(); i++) {
+        particles[i]->p = glm::vec3(gridP.x[i], gridP.y[i], gridP.z[i]);
+        particles[i]->v = glm::vec3(gridV.x[i], gridV.y[i], gridV.z[i]);
+        particles[i]->f = glm::vec3(0.0f);
+    }
+}
+
+bool Cloth::updateTile(GridTile& tile, unsigned int tileRow, unsigned int tileCol, unsigned int substeps, unsigned int level) {
+    // every step leaves the outermost reach of the block stale, so the halo covers all of them
+    unsigned int steps = substeps >> level;
+    float dt = TIME_STEP * (1 << level);
+    unsigned int reach = bendKs > 0.0f ? glm::max(1u, bendStride) : 1;
+    unsigned int halo = steps * reach;
+    unsigned int r0 = tileRow * TILE_SIZE, r1 = glm::min(height, r0 + TILE_SIZE);
+    unsigned int c0 = tileCol * TILE_SIZE, c1 = glm::min(width, c0 + TILE_SIZE);
+    unsigned int br0 = r0 > halo ? r0 - halo : 0, br1 = glm::min(height, r1 + halo);
+    unsigned int bc0 = c0 > halo ? c0 - halo : 0, bc1 = glm::min(width, c1 + halo);
+    unsigned int cols = bc1 - bc0, rows = br1 - br0;
+    unsigned int n = cols * rows;
+    tile.fit(n);
+    
+    for (unsigned int h = 0; h < rows; h++) {
+        unsigned int src = (br0 + h) * width + bc0;
+        unsigned int dst = h * cols;
+        copy_n(&gridP.x[src], cols, &tile.p.x[dst]);
+        copy_n(&gridP.y[src], cols, &tile.p.y[dst]);
+        copy_n(&gridP.z[src], cols, &tile.p.z[dst]);
+        copy_n(&gridV.x[src], cols, &tile.v.x[dst]);
+        copy_n(&gridV.y[src], cols, &tile.v.y[dst]);
+        copy_n(&gridV.z[src], cols, &tile.v.z[dst]);
+        copy_n(&gridM[src], cols, &tile.m[dst]);
+        copy_n(&gridFixed[src], cols, &tile.fixed[dst]);
+    }
+    
+    // all phases of the substeps run while the block is in cache
+    unsigned int numSpans = bendKs > 0.0f ? 2 : 1;
+    glm::vec3 g = G;
+    for (unsigned int step = 0; step < steps; step++) {
+        for (unsigned int span = 0; span < numSpans; span++) {
+            computeGridEdges(tile.p, tile.v, tile.edges, cols, rows, 0, rows, span);
+            gatherGridEdges(tile.edges, tile.f, cols, 0, rows, span);
+        }
+        
+        for (unsigned int h = 0; h + 1 < rows; h++) {
+            for (unsigned int w = 0; w + 1 < cols; w++) {
+                unsigned int curr = h * cols + w;
+                unsigned int right = curr + 1;
+                unsigned int up = curr + cols;
+                unsigned int upRight = up + 1;
+                if (windField) { // the two triangles initTriangles made for this square
+                    unsigned int k = 2 * ((br0 + h) * (width - 1) + bc0 + w);
+                    applyGridAero(tile, curr, upRight, up, glm::vec3(triangleWind.x[k], triangleWind.y[k], triangleWind.z[k]));
+                    applyGridAero(tile, curr, right, upRight, glm::vec3(triangleWind.x[k + 1], triangleWind.y[k + 1], triangleWind.z[k + 1]));
+                    continue;
+                }
+                applyGridAero(tile, curr, upRight, up, wind);
+                applyGridAero(tile, curr, right, upRight, wind);
+            }
+        }
+        
+        // forward euler as in Particle::update
+        for (unsigned int i = 0; i < n; i++) {
+            if (tile.fixed[i]) continue;
+            float m = tile.m[i];
+            tile.v.x[i] += dt * ((tile.f.x[i] + m * g.x) / m);
+            tile.v.y[i] += dt * ((tile.f.y[i] + m * g.y) / m);
+            tile.v.z[i] += dt * ((tile.f.z[i] + m * g.z) / m);
+            tile.p.x[i] += dt * tile.v.x[i];
+            tile.p.y[i] += dt * tile.v.y[i];
+            tile.p.z[i] += dt * tile.v.z[i];
+        }
+        
+        // with a strain limit the collisions follow it on the assembled grid, see updateTiled
+        if (terrain && strainLimit <= 0.0f) {
+            terrain->handleCollision(tile.p.x.data(), tile.p.y.data(), tile.p.z.data(),
+                                     tile.v.x.data(), tile.v.y.data(), tile.v.z.data(),
+                                     n, ELASTICITY, FRICTION, EPSILON);
+        }
+    }
+    
+    // settled: low kinetic energy, and no particle drifting as a net force would make it;
+    // resting contact keeps a small bounce in v, so the drift is measured on the positions
+    float maxStep = SLEEP_DRIFT * substeps;
+    double speed2 = 0.0;
+    bool calm = true;
+    for (unsigned int h = r0; h < r1 && calm; h++) {
+        for (unsigned int w = c0; w < c1; w++) {
+            unsigned int i = (h - br0) * cols + (w - bc0);
+            unsigned int id = h * width + w;
+            glm::vec3 step = glm::vec3(tile.p.x[i], tile.p.y[i], tile.p.z[i]) - glm::vec3(gridP.x[id], gridP.y[id], gridP.z[id]);
+            // written so that a NaN never counts as settled
+            if (!(glm::dot(step, step) <= maxStep * maxStep)) {
+                calm = false;
+                break;
+            }
+            speed2 += tile.v.x[i] * tile.v.x[i] + tile.v.y[i] * tile.v.y[i] + tile.v.z[i] * tile.v.z[i];
+        }
+    }
+    calm = calm && speed2 <= (double) (r1 - r0) * (c1 - c0) * SLEEP_SPEED * SLEEP_SPEED;
+    
+    // only the tile itself is valid after the substeps
+    for (unsigned int h = r0; h < r1; h++) {
+        unsigned int src = (h - br0) * cols + (c0 - bc0);
+        unsigned int dst = h * width + c0;
+        copy_n(&tile.p.x[src], c1 - c0, &nextP.x[dst]);
+        copy_n(&tile.p.y[src], c1 - c0, &nextP.y[dst]);
+        copy_n(&tile.p.z[src], c1 - c0, &nextP.z[dst]);
+        copy_n(&tile.v.x[src], c1 - c0, &nextV.x[dst]);
+        copy_n(&tile.v.y[src], c1 - c0, &nextV.y[dst]);
+        copy_n(&tile.v.z[src], c1 - c0, &nextV.z[dst]);
+    }
+    return calm;
+}
+
+void Cloth::assignTileLevels(unsigned int tileRows, unsigned int tileCols, unsigned int substeps) {
+    unsigned int maxLevel = 0;
+    while (maxLevel + 1 < MULTIRATE_LEVELS && substeps % (2u << maxLevel) == 0) maxLevel++;
+    if (maxLevel == 0) return;
+    
+    // the stiffest mode of the stencil, neighbours moving against each other along a row, has stiffness
+    // and damping of 8 Ks / m and 8 Kd / m (4 from the row, 4 from the diagonals at half projection);
+    // symplectic Euler with explicit damping is stable on it while dt^2 Ks' / 4 + dt Kd' / 2 < 1
+    float stiffness = 8.0f * (Ks + glm::max(0.0f, bendKs));
+    float damping = 8.0f * Kd * (bendKs > 0.0f ? 2.0f : 1.0f);
+    
+    Parallel::forRange(tileRows * tileCols, 1, [&](size_t begin, size_t end) {
+        for (size_t t = begin; t < end; t++) {
+            unsigned int r0 = (unsigned int) t / tileCols * TILE_SIZE, r1 = glm::min(height, r0 + TILE_SIZE);
+            unsigned int c0 = (unsigned int) t % tileCols * TILE_SIZE, c1 = glm::min(width, c0 + TILE_SIZE);
+            float minMass = FLT_MAX, maxSpeed2 = 0.0f, maxStretch2 = 0.0f;
+            bool held = false;
+            for (unsigned int h = r0; h < r1 && !held; h++) {
+                for (unsigned int w = c0; w < c1; w++) {
+                    unsigned int i = h * width + w;
+                    if (gridFixed[i]) {
+                        held = true;
+                        break;
+                    }
+                    // the edges to the right and up, so every structural spring is seen once
+                    glm::vec3 p(gridP.x[i], gridP.y[i], gridP.z[i]);
+                    if (w + 1 < width) {
+                        glm::vec3 e = glm::vec3(gridP.x[i + 1], gridP.y[i + 1], gridP.z[i + 1]) - p;
+                        maxStretch2 = glm::max(maxStretch2, glm::dot(e, e));
+                    }
+                    if (h + 1 < height) {
+                        glm::vec3 e = glm::vec3(gridP.x[i + width], gridP.y[i + width], gridP.z[i + width]) - p;
+                        maxStretch2 = glm::max(maxStretch2, glm::dot(e, e));
+                    }
+                    if (terrain && p.y - terrain->getHeight(p.x, p.z) < MULTIRATE_CONTACT * offset) {
+                        held = true;
+                        break;
+                    }
+                    minMass = glm::min(minMass, gridM[i]);
+                    maxSpeed2 = glm::max(maxSpeed2, gridV.x[i] * gridV.x[i] + gridV.y[i] * gridV.y[i] + gridV.z[i] * gridV.z[i]);
+                }
+            }
+            float maxLength = (1.0f + MULTIRATE_STRAIN) * offset;
+            
+            // pins, contact and high strain keep the smallest step; otherwise the largest step that is stable
+            // and moves no particle too far, written so that a NaN keeps the smallest step
+            unsigned int level = 0;
+            if (!held && maxStretch2 <= maxLength * maxLength) {
+                float speed = sqrt(maxSpeed2);
+                while (level < maxLevel) {
+                    float dt = TIME_STEP * (2 << level);
+                    float stability = (dt * dt * stiffness / 4.0f + dt * damping / 2.0f) / minMass;
+                    if (!(stability <= MULTIRATE_SAFETY && speed * dt <= MULTIRATE_TRAVEL * offset)) break;
+                    level++;
+                }
+            }
+            tileLevel[t] = (unsigned char) level;
+        }
+    });
+    
+    // a tile steps at most twice as long as its neighbours, so the interfaces stay close in time
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (unsigned int t = 0; t < tileRows * tileCols; t++) {
+            unsigned int row = t / tileCols, col = t % tileCols;
+            for (unsigned int r = row > 0 ? row - 1 : 0; r <= row + 1 && r < tileRows; r++) {
+                for (unsigned int c = col > 0 ? col - 1 : 0; c <= col + 1 && c < tileCols; c++) {
+                    if (tileLevel[t] > tileLevel[r * tileCols + c] + 1) {
+                        tileLevel[t] = tileLevel[r * tileCols + c] + 1;
+                        changed = true;
+                    }
+                }
+            }
+        }
+    }
+}
+
+unsigned int Cloth::getCoarseTiles() {
+    return (unsigned int) (tileLevel.size() - count(tileLevel.begin(), tileLevel.end(), 0));
+}
+
+unsigned int Cloth::getTileCount() {
+    if (!gridStencil) return 0;
+    return ((height + TILE_SIZE - 1) / TILE_SIZE) * ((width + TILE_SIZE - 1) / TILE_SIZE);
+}
+
+void Cloth::holdTile(unsigned int tileRow, unsigned int tileCol) {
+    unsigned int r0 = tileRow * TILE_SIZE, r1 = glm::min(height, r0 + TILE_SIZE);
+    unsigned int c0 = tileCol * TILE_SIZE, c1 = glm::min(width, c0 + TILE_SIZE);
+    for (unsigned int h = r0; h < r1; h++) {
+        unsigned int id = h * width + c0;
+        copy_n(&gridP.x[id], c1 - c0, &nextP.x[id]);
+        copy_n(&gridP.y[id], c1 - c0, &nextP.y[id]);
+        copy_n(&gridP.z[id], c1 - c0, &nextP.z[id]);
+        copy_n(&gridV.x[id], c1 - c0, &nextV.x[id]);
+        copy_n(&gridV.y[id], c1 - c0, &nextV.y[id]);
+        copy_n(&gridV.z[id], c1 - c0, &nextV.z[id]);
+    }
+}
+
+void Cloth::settleTiles(unsigned int tileRows, unsigned int tileCols) {
+    // a tile that still moves pulls on its neighbours through the springs
+    vector<unsigned char> disturbed(tileRows * tileCols, 0);
+    for (unsigned int t = 0; t < tileRows * tileCols; t++) {
+        if (tileAsleep[t]) continue;
+        if (tileCalm[t]) {
+            tileCalmFrames[t]++;
+            continue;
+        }
+        tileCalmFrames[t] = 0;
+        unsigned int row = t / tileCols, col = t % tileCols;
+        for (unsigned int r = row > 0 ? row - 1 : 0; r <= row + 1 && r < tileRows; r++) {
+            for (unsigned int c = col > 0 ? col - 1 : 0; c <= col + 1 && c < tileCols; c++) {
+                disturbed[r * tileCols + c] = 1;
+            }
+        }
+    }
+    
+    for (unsigned int t = 0; t < tileRows * tileCols; t++) {
+        if (tileAsleep[t]) {
+            if (disturbed[t]) {
+                tileAsleep[t] = 0;
+                tileCalmFrames[t] = 0;
+            }
+            continue;
+        }
+        if (tileCalmFrames[t] < SLEEP_FRAMES) continue;
+        
+        // sleep at rest, so the tile wakes without the velocity it had
+        tileAsleep[t] = 1;
+        unsigned int r0 = (t / tileCols) * TILE_SIZE, r1 = glm::min(height, r0 + TILE_SIZE);
+        unsigned int c0 = (t % tileCols) * TILE_SIZE, c1 = glm::min(width, c0 + TILE_SIZE);
+        for (unsigned int h = r0; h < r1; h++) {
+            fill_n(&gridV.x[h * width + c0], c1 - c0, 0.0f);
+            fill_n(&gridV.y[h * width + c0], c1 - c0, 0.0f);
+            fill_n(&gridV.z[h * width + c0], c1 - c0, 0.0f);
+        }
+    }
+}
+
+void Cloth::wakeTiles() {
+    fill(tileAsleep.begin(), tileAsleep.end(), 0);
+    fill(tileCalmFrames.begin(), tileCalmFrames.end(), 0);
+}
+
+void Cloth::wakeTileOf(unsigned int id) {
+    if (tileAsleep.empty()) return;
+    unsigned int tileCols = (width + TILE_SIZE - 1) / TILE_SIZE;
+    unsigned int t = (id / width / TILE_SIZE) * tileCols + (id % width) / TILE_SIZE;
+    tileAsleep[t] = 0;
+    tileCalmFrames[t] = 0;
+}
+
+void Cloth::setSleeping(bool sleeping) {
+    this->sleeping = sleeping;
+    wakeTiles();
+}
+
+unsigned int Cloth::getSleepingTiles() {
+    if (!sleeping) return 0;
+    return (unsigned int) count(tileAsleep.begin(), tileAsleep.end(), 1);
+}
+
+void Cloth::setStrainLimit(float limit) {
+    strainLimit = limit;
+    if (limit > 0.0f && !gridStencil && colorStart.empty()) {
+        colorSprings();
+    }
+    wakeTiles();
+}
+
+void Cloth::colorSprings() {
+    unordered_map<const Particle*, unsigned int> id(particles.size());
+    for (unsigned int i = 0; i < particles.size(); i++) {
+        id[particles[i]] = i;
+    }
+    
+    // greedy: the lowest colour neither end has yet; bend springs are left to bend
+    vector<uint64_t> taken(particles.size(), 0);
+    vector<unsigned int> color(springDampers.size(), STRAIN_COLORS);
+    vector<size_t> count(STRAIN_COLORS + 1, 0);
+    for (unsigned int k = 0; k < springDampers.size(); k++) {
+        SpringDamper* s = springDampers[k];
+        if (!s->stretch) continue;
+        unsigned int a = id[s->p1], b = id[s->p2];
+        uint64_t both = taken[a] | taken[b];
+        unsigned int c = 0;
+        while (c < STRAIN_COLORS && (both >> c) & 1) c++;
+        if (c < STRAIN_COLORS) {
+            taken[a] |= (uint64_t) 1 << c;
+            taken[b] |= (uint64_t) 1 << c;
+        }
+        color[k] = c;
+        count[c]++;
+    }
+    
+    // springs that found no colour go last, into a set of their own
+    colorStart.assign(STRAIN_COLORS + 2, 0);
+    for (unsigned int c = 0; c <= STRAIN_COLORS; c++) {
+        colorStart[c + 1] = colorStart[c] + count[c];
+    }
+    limitedSprings.assign(colorStart.back(), NULL);
+    vector<size_t> fill(colorStart.begin(), colorStart.end() - 1);
+    for (unsigned int k = 0; k < springDampers.size(); k++) {
+        if (!springDampers[k]->stretch) continue;
+        limitedSprings[fill[color[k]]++] = springDampers[k];
+    }
+}
+
+void Cloth::limitSpringStrain() {
+    float stretch = 1.0f + strainLimit;
+    for (unsigned int sweep = 0; sweep < STRAIN_SWEEPS; sweep++) {
+        for (unsigned int c = 0; c < STRAIN_COLORS; c++) {
+            size_t first = colorStart[c];
+            Parallel::forRange(colorStart[c + 1] - first, PARALLEL_GRAIN, [this, first, stretch](size_t begin, size_t end) {
+                for (size_t k = first + begin; k < first + end; k++) {
+                    limitedSprings[k]->limitStretch(stretch * limitedSprings[k]->l, TIME_STEP);
+                }
+            });
+        }
+        for (size_t k = colorStart[STRAIN_COLORS]; k < colorStart[STRAIN_COLORS + 1]; k++) {
+            limitedSprings[k]->limitStretch(stretch * limitedSprings[k]->l, TIME_STEP);
+        }
+    }
+}
+
+void Cloth::limitGridStrain(GridField& p, GridField& v, const float* m, const unsigned char* fixed,
+                            unsigned int cols, unsigned int rows, float deltaTime) {
+    // a colour is one direction and one parity, so no two of its edges share a particle
+    size_t rowGrain = glm::max(1u, PARALLEL_GRAIN / cols);
+    for (unsigned int sweep = 0; sweep < STRAIN_SWEEPS; sweep++) {
+        for (unsigned int d = 0; d < GRID_DIRECTIONS; d++) {
+            for (unsigned int parity = 0; parity < 2; parity++) {
+                Parallel::forRange(rows, rowGrain, [&, d, parity](size_t begin, size_t end) {
+                    limitGridEdges(p, v, m, fixed, cols, rows, deltaTime, d, parity, (unsigned int) begin, (unsigned int) end);
+                });
+            }
+        }
+    }
+}
+
+void Cloth::limitGridEdges(GridField& p, GridField& v, const float* m, const unsigned char* fixed,
+                           unsigned int cols, unsigned int rows, float deltaTime, unsigned int d, unsigned int parity,
+                           unsigned int rowBegin, unsigned int rowEnd) {
+    // the same moves as SpringDamper::limitStretch on the structural and shear edges
+    int dw = stencilW[d];
+    int dh = stencilH[d];
+    int next = dh * (int) cols + dw;
+    float maxLength = (1.0f + strainLimit) * (dw != 0 && dh != 0 ? sqrt(2.0f) * offset : offset);
+    float invStep = 1.0f / deltaTime;
+    
+    // edges along a row alternate by column, the others by row
+    unsigned int wBegin = dw < 0 ? 1 : 0;
+    unsigned int wEnd = dw > 0 ? cols - 1 : cols;
+    unsigned int wStep = 1;
+    if (dh == 0) {
+        wBegin += parity;
+        wStep = 2;
+    }
+    
+    float* __restrict px = p.x.data();
+    float* __restrict py = p.y.data();
+    float* __restrict pz = p.z.data();
+    float* __restrict vx = v.x.data();
+    float* __restrict vy = v.y.data();
+    float* __restrict vz = v.z.data();
+    for (unsigned int h = rowBegin; h < rowEnd && h + dh < rows; h++) {
+        if (dh != 0 && h % 2 != parity) continue;
+        for (unsigned int w = wBegin; w < wEnd; w += wStep) {
+            unsigned int a = h * cols + w;
+            unsigned int b = a + next;
+            float x = px[b] - px[a];
+            float y = py[b] - py[a];
+            float z = pz[b] - pz[a];
+            float len2 = x * x + y * y + z * z;
+            if (!(len2 > maxLength * maxLength)) continue;
+            
+            float wa = fixed[a] ? 0.0f : 1.0f / m[a];
+            float wb = fixed[b] ? 0.0f : 1.0f / m[b];
+            if (wa + wb == 0.0f) continue;
+            float len = sqrt(len2);
+            float s = (len - maxLength) / (len * (wa + wb));
+            px[a] += wa * s * x;
+            py[a] += wa * s * y;
+            pz[a] += wa * s * z;
+            px[b] -= wb * s * x;
+            py[b] -= wb * s * y;
+            pz[b] -= wb * s * z;
+            vx[a] += wa * s * invStep * x;
+            vy[a] += wa * s * invStep * y;
+            vz[a] += wa * s * invStep * z;
+            vx[b] -= wb * s * invStep * x;
+            vy[b] -= wb * s * invStep * y;
+            vz[b] -= wb * s * invStep * z;
+        }
+    }
+}
+
+void Cloth::applyGridAero(GridTile& tile, unsigned int a, unsigned int b, unsigned int c, const glm::vec3& vair) {
+    // the same expression as Triangle::applyAeroForce
+    glm::vec3 va(tile.v.x[a], tile.v.y[a], tile.v.z[a]);
+    glm::vec3 vb(tile.v.x[b], tile.v.y[b], tile.v.z[b]);
+    glm::vec3 vc(tile.v.x[c], tile.v.y[c], tile.v.z[c]);
+    glm::vec3 v = ((va + vb + vc) / 3.0f) - vair;
+    float vLen = glm::length(v);
+    if (vLen == 0) return;
+    
+    glm::vec3 pa(tile.p.x[a], tile.p.y[a], tile.p.z[a]);
+    glm::vec3 ab = glm::vec3(tile.p.x[b], tile.p.y[b], tile.p.z[b]) - pa;
+    glm::vec3 ac = glm::vec3(tile.p.x[c], tile.p.y[c], tile.p.z[c]) - pa;
+    glm::vec3 normal = glm::cross(ab, ac);
+    float normalLen = glm::length(normal);
+    glm::vec3 n = normal / normalLen;
+    
+    glm::vec3 faero = -0.25f * AIR_DENSITY * normalLen * glm::dot(v, n) * vLen * DRAG * n;
+    glm::vec3 feach = faero / 3.0f;
+    for (unsigned int i : {a, b, c}) {
+        tile.f.x[i] += feach.x;
+        tile.f.y[i] += feach.y;
+        tile.f.z[i] += feach.z;
+    }
+}
+
+void Cloth::applyAeroForces() {
+    if (windField) {
+        for (unsigned int k = 0; k < triangles.size(); k++) {
+            glm::vec3 vair(triangleWind.x[k], triangleWind.y[k], triangleWind.z[k]);
+            triangles[k]->applyAeroForce(vair, AIR_DENSITY, DRAG);
+        }
+    }
+    else {
+        for (Triangle* t : triangles) {
+            t->applyAeroForce(wind, AIR_DENSITY, DRAG);
+        }
+    }
+}
+
+void Cloth::sampleWind() {
+    if (particleWind.x.size() != particles.size()) {
+        windAt.resize(particles.size());
+        particleWind.resize(particles.size());
+    }
+    if (triangleWind.x.size() != triangles.size()) {
+        triangleWind.resize(triangles.size());
+    }
+    
+    // the field changes slowly next to a substep, so every substep of the frame uses the same samples;
+    // one lookup per particle, about half as many as triangles
+    Parallel::forRange(particles.size(), PARALLEL_GRAIN, [this](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            windAt.x[i] = particles[i]->p.x;
+            windAt.y[i] = particles[i]->p.y;
+            windAt.z[i] = particles[i]->p.z;
+        }
+        windField->sample(&windAt.x[begin], &windAt.y[begin], &windAt.z[begin], end - begin, wind, windTime,
+                          &particleWind.x[begin], &particleWind.y[begin], &particleWind.z[begin]);
+    });
+    
+    // a triangle feels the mean wind at its corners, as it moves with the mean of their velocities
+    Parallel::forRange(triangles.size(), PARALLEL_GRAIN, [this](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; k++) {
+            unsigned int a = indices[3 * k], b = indices[3 * k + 1], c = indices[3 * k + 2];
+            triangleWind.x[k] = (particleWind.x[a] + particleWind.x[b] + particleWind.x[c]) / 3.0f;
+            triangleWind.y[k] = (particleWind.y[a] + particleWind.y[b] + particleWind.y[c]) / 3.0f;
+            triangleWind.z[k] = (particleWind.z[a] + particleWind.z[b] + particleWind.z[c]) / 3.0f;
+        }
+    });
+}
+
 void Cloth::updateNormals() {
     // first clear the normal for each particle
     for (Particle* p : particles) {
@@ -121,59 +888,197 @@ void Cloth::updateNormals() {
     }
     
     // normalize the normals for each particle
+    // only normals that changed are uploaded again
     for (unsigned int i = 0; i < particles.size(); i++) {
         particles[i]->n = glm::normalize(particles[i]->n);
+        if (normals[i] == particles[i]->n) continue;
         normals[i] = particles[i]->n;
+        markDirty(dirtyNormals, i, i + 1);
     }
 }
 
+void Cloth::markDirty(vector<pair<unsigned int, unsigned int>>& ranges, unsigned int begin, unsigned int end) {
+    // sweeps mark in increasing order, so a close range just grows the last one
+    if (!ranges.empty() && begin >= ranges.back().first && begin <= ranges.back().second + DIRTY_GAP) {
+        ranges.back().second = glm::max(ranges.back().second, end);
+        return;
+    }
+    ranges.push_back(make_pair(begin, end));
+}
+
+void Cloth::uploadRanges(GLuint buffer, const vector<glm::vec3>& data, vector<pair<unsigned int, unsigned int>>& ranges) {
+    if (ranges.empty()) return;
+    
+    // coalesce ranges that overlap or lie close together into one call
+    sort(ranges.begin(), ranges.end());
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    unsigned int begin = ranges[0].first, end = ranges[0].second;
+    for (size_t r = 1; r <= ranges.size(); r++) {
+        if (r < ranges.size() && ranges[r].first <= end + DIRTY_GAP) {
+            end = glm::max(end, ranges[r].second);
+            continue;
+        }
+        glBufferSubData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * begin, sizeof(glm::vec3) * (end - begin), data.data() + begin);
+        if (r < ranges.size()) {
+            begin = ranges[r].first;
+            end = ranges[r].second;
+        }
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    ranges.clear();
+}
+
 void Cloth::initBuffers() {
     // generate a vertex array (VAO) and two vertex buffer objects (VBO).
     glGenVertexArrays(1, &VAO);
     glGenBuffers(1, &VBO_positions);
     glGenBuffers(1, &VBO_normals);
+    glGenBuffers(1, &VBO_previousPositions);
+    glGenBuffers(1, &VBO_previousNormals);
     glGenBuffers(1, &EBO);
     
     // bind to the VAO.
     glBindVertexArray(VAO);
     
-    // bind to the first VBO - We will use it to store the vertices
+    // bind to the first VBO - We will use it to store the vertices, filled by uploadBuffers
     glBindBuffer(GL_ARRAY_BUFFER, VBO_positions);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * positions.size(), positions.data(), GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * positions.size(), NULL, GL_DYNAMIC_DRAW);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), 0);
 
     // bind to the second VBO - We will use it to store the normals
     glBindBuffer(GL_ARRAY_BUFFER, VBO_normals);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * normals.size(), normals.data(), GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * normals.size(), NULL, GL_DYNAMIC_DRAW);
     glEnableVertexAttribArray(1);
     glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), 0);
 
-    // bind the EBO to the bound VAO and send the data
+    // the state before the last step, filled by keepPrevious
+    glBindBuffer(GL_ARRAY_BUFFER, VBO_previousPositions);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * positions.size(), NULL, GL_DYNAMIC_COPY);
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), 0);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO_previousNormals);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * normals.size(), NULL, GL_DYNAMIC_COPY);
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), 0);
+
+    // bind the EBO to the bound VAO
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * indices.size(), indices.data(), GL_STATIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * indices.size(), NULL, GL_STATIC_DRAW);
 
     // unbind the VBOs.
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
+    uploadedBytes = 0;
+    previousKept = false;
 }
 
-void Cloth::updateBuffers() {
-    glBindVertexArray(VAO);
+void Cloth::resizeBuffers() {
+    dirtyPositions.clear();
+    dirtyNormals.clear();
+    uploadedBytes = 0;
+    previousKept = false;
+    if (!VAO) return;
     
-    // Bind to the first VBO - We will use it to store the vertices
+    glBindVertexArray(VAO);
     glBindBuffer(GL_ARRAY_BUFFER, VBO_positions);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * positions.size(), positions.data(), GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * positions.size(), NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO_normals);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * normals.size(), NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO_previousPositions);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * positions.size(), NULL, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO_previousNormals);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * normals.size(), NULL, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * indices.size(), NULL, GL_STATIC_DRAW);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+}
 
-    // Bind to the second VBO - We will use it to store the normals
-    glBindBuffer(GL_ARRAY_BUFFER, VBO_normals);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3)* normals.size(), normals.data(), GL_STATIC_DRAW);
+size_t Cloth::getBufferBytes() {
+    return sizeof(glm::vec3) * (positions.size() + normals.size()) + sizeof(unsigned int) * indices.size();
+}
+
+bool Cloth::isUploaded() {
+    return VAO && uploadedBytes == getBufferBytes();
+}
+
+bool Cloth::uploadBuffers(size_t budget) {
+    if (!VAO) initBuffers();
+    
+    // positions, normals and indices are sent as one stream, a slice per call
+    const size_t positionBytes = sizeof(glm::vec3) * positions.size();
+    const size_t normalBytes = sizeof(glm::vec3) * normals.size();
+    const size_t total = getBufferBytes();
+    glBindVertexArray(VAO);
+    while (budget > 0 && uploadedBytes < total) {
+        GLenum target = GL_ARRAY_BUFFER;
+        const char* data;
+        size_t begin, size;
+        if (uploadedBytes < positionBytes) {
+            glBindBuffer(GL_ARRAY_BUFFER, VBO_positions);
+            data = (const char*) positions.data();
+            begin = uploadedBytes;
+            size = positionBytes;
+        }
+        else if (uploadedBytes < positionBytes + normalBytes) {
+            glBindBuffer(GL_ARRAY_BUFFER, VBO_normals);
+            data = (const char*) normals.data();
+            begin = uploadedBytes - positionBytes;
+            size = normalBytes;
+        }
+        else {
+            target = GL_ELEMENT_ARRAY_BUFFER; // already bound to the VAO
+            data = (const char*) indices.data();
+            begin = uploadedBytes - positionBytes - normalBytes;
+            size = total - positionBytes - normalBytes;
+        }
+        size_t slice = glm::min(size - begin, budget);
+        glBufferSubData(target, begin, slice, data + begin);
+        uploadedBytes += slice;
+        budget -= slice;
+    }
     glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+    return uploadedBytes == total;
+}
+
+void Cloth::updateBuffers() {
+    // the rest goes out with the next slices of uploadBuffers, which send the arrays whole
+    if (!isUploaded()) {
+        dirtyPositions.clear();
+        dirtyNormals.clear();
+        return;
+    }
     
+    // only the ranges that changed since the last upload
+    glBindVertexArray(VAO);
+    uploadRanges(VBO_positions, positions, dirtyPositions);
+    uploadRanges(VBO_normals, normals, dirtyNormals);
     glBindVertexArray(0);
 }
 
+void Cloth::keepPrevious() {
+    // a cloth still streaming in, or sent again after a reorder or remesh, has no previous step yet;
+    // one drawn at the steps themselves needs none, and the copies would only add GPU traffic
+    previousKept = blend < 1.0f && isUploaded();
+    if (!previousKept) return;
+    
+    // whole buffers on the GPU, ranges that did not change this step may have changed the one before
+    glBindBuffer(GL_COPY_READ_BUFFER, VBO_positions);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, VBO_previousPositions);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, sizeof(glm::vec3) * positions.size());
+    glBindBuffer(GL_COPY_READ_BUFFER, VBO_normals);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, VBO_previousNormals);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, sizeof(glm::vec3) * normals.size());
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void Cloth::setBlend(float alpha) {
+    blend = alpha;
+}
+
 void Cloth::draw(const glm::mat4& viewProjMtx, GLuint shader) {
     glUseProgram(shader);
 
@@ -182,50 +1087,359 @@ void Cloth::draw(const glm::mat4& viewProjMtx, GLuint shader) {
     glUniformMatrix4fv(glGetUniformLocation(shader, "model"), 1, GL_FALSE, (float*)&model);
     glUniform3fv(glGetUniformLocation(shader, "DiffuseColor"), 1, &color[0]);
 
+    // cloths built without a context are sent whole on their first draw
+    uploadBuffers(SIZE_MAX);
+    glUniform1f(glGetUniformLocation(shader, "blend"), previousKept ? blend : 1.0f);
+
     // Bind the VAO
     glBindVertexArray(VAO);
     
     // draw the points using triangles, indexed with the EBO
     glDrawElements(GL_TRIANGLES, (unsigned int) indices.size(), GL_UNSIGNED_INT, 0);
     
-    // Unbind the VAO and shader program
+    // Unbind the VAO and shader program, other objects are drawn without blending
     glBindVertexArray(0);
+    glUniform1f(glGetUniformLocation(shader, "blend"), 1.0f);
     glUseProgram(0);
 }
 
 void Cloth::update() {
-    // oversampling to improve system stability
-    for (unsigned int i = 0; i < NUM_SAMPLE; i++) {
-        // apply forces and update position of each vertex
-        for (SpringDamper* s : springDampers) {
-            s->applyForce();
+    if (windField) {
+        PROFILE_SCOPE(PHASE_AERO);
+        sampleWind();
+        // gusts push on settled tiles too
+        if (sleeping && wind != glm::vec3(0.0f)) wakeTiles();
+    }
+    
+    if (projective) {
+        updateProjective();
+    }
+    // tiles run every phase of the substeps on a cache-sized block at a time
+    else if (gridStencil && tiled) {
+        PROFILE_SCOPE(PHASE_TILES);
+        updateTiled();
+    }
+    else {
+        // oversampling to improve system stability
+        for (unsigned int i = 0; i < NUM_SAMPLE; i++) {
+            TRACE_SCOPE("substep");
+            
+            // apply forces and update position of each vertex
+            {
+                PROFILE_SCOPE(PHASE_SPRINGS);
+                if (gridStencil) {
+                    applyGridForces();
+                }
+                else {
+                    for (SpringDamper* s : springDampers) {
+                        s->applyForce();
+                    }
+                }
+            }
+            {
+                PROFILE_SCOPE(PHASE_AERO);
+                applyAeroForces();
+            }
+            {
+                PROFILE_SCOPE(PHASE_INTEGRATE);
+                // particles are independent here, so large cloths split them over threads
+                Parallel::forRange(particles.size(), PARALLEL_GRAIN, [this](size_t begin, size_t end) {
+                    for (size_t j = begin; j < end; j++) {
+                        Particle* particle = particles[j];
+                        glm::vec3 gForce = particle->m * G;
+                        particle->applyForce(gForce);
+                        particle->update(TIME_STEP);
+                    }
+                });
+            }
+            if (strainLimit > 0.0f) {
+                PROFILE_SCOPE(PHASE_STRAIN);
+                if (gridStencil) {
+                    for (unsigned int j = 0; j < particles.size(); j++) {
+                        gridP.x[j] = particles[j]->p.x;
+                        gridP.y[j] = particles[j]->p.y;
+                        gridP.z[j] = particles[j]->p.z;
+                        gridV.x[j] = particles[j]->v.x;
+                        gridV.y[j] = particles[j]->v.y;
+                        gridV.z[j] = particles[j]->v.z;
+                        gridM[j] = particles[j]->m;
+                        gridFixed[j] = particles[j]->fixed;
+                    }
+                    limitGridStrain(gridP, gridV, gridM.data(), gridFixed.data(), width, height, TIME_STEP);
+                    for (unsigned int j = 0; j < particles.size(); j++) {
+                        particles[j]->p = glm::vec3(gridP.x[j], gridP.y[j], gridP.z[j]);
+                        particles[j]->v = glm::vec3(gridV.x[j], gridV.y[j], gridV.z[j]);
+                    }
+                }
+                else {
+                    limitSpringStrain();
+                }
+            }
+            {
+                PROFILE_SCOPE(PHASE_COLLISION);
+                handleCollision();
+            }
         }
-        for (Triangle* t : triangles) {
-            t->applyAeroForce(wind, AIR_DENSITY, DRAG);
+    }
+    
+    windTime += NUM_SAMPLE * TIME_STEP;
+    
+    // update the buffers for rendering
+    {
+        PROFILE_SCOPE(PHASE_NORMALS);
+        for (unsigned int i = 0; i < particles.size(); i++) {
+            if (positions[i] == particles[i]->p) continue;
+            positions[i] = particles[i]->p;
+            markDirty(dirtyPositions, i, i + 1);
         }
-        for (Particle* particle : particles) {
-            glm::vec3 gForce = particle->m * G;
-            particle->applyForce(gForce);
-            particle->update(TIME_STEP);
-            handleCollision(particle);
+        updateNormals();
+    }
+    if (remesher) {
+        PROFILE_SCOPE(PHASE_REMESH);
+        if (remesher->update()) topologyChanged();
+    }
+    {
+        PROFILE_SCOPE(PHASE_UPLOAD);
+        keepPrevious();
+        updateBuffers();
+    }
+}
+
+void Cloth::updateProjective() {
+    // one implicit step covers all substeps of the frame, so there is one aero pass and one collision pass
+    {
+        PROFILE_SCOPE(PHASE_AERO);
+        applyAeroForces();
+    }
+    {
+        PROFILE_SCOPE(PHASE_INTEGRATE);
+        if (!projective->step(particles, G)) {
+            cerr << "Projective Dynamics system is not positive definite, integrating explicitly" << endl;
+            delete projective;
+            projective = NULL;
+            return;
         }
     }
+    {
+        PROFILE_SCOPE(PHASE_COLLISION);
+        handleCollision();
+    }
+}
+
+void Cloth::setProjective(bool enabled) {
+    if (enabled == (projective != NULL)) return;
+    if (!enabled) {
+        delete projective;
+        projective = NULL;
+        return;
+    }
     
-    // update the buffers for rendering
+    // every spring of the cloth; grid cloths list the ones their stencil evaluates
+    vector<ProjectiveSpring> springs;
+    if (gridStencil) {
+        unsigned int numSpans = bendKs > 0.0f ? 2 : 1;
+        for (unsigned int span = 0; span < numSpans; span++) {
+            int stride = span == 0 ? 1 : (int) bendStride;
+            float k = span == 0 ? Ks : bendKs;
+            for (unsigned int d = 0; d < GRID_DIRECTIONS; d++) {
+                int dw = stride * stencilW[d];
+                int dh = stride * stencilH[d];
+                float l = stride * offset * (stencilW[d] != 0 && stencilH[d] != 0 ? sqrt(2.0f) : 1.0f);
+                for (unsigned int h = 0; h + dh < height; h++) {
+                    for (unsigned int w = 0; w < width; w++) {
+                        if ((int) w + dw < 0 || (int) w + dw >= (int) width) continue;
+                        springs.push_back({h * width + w, (h + dh) * width + w + dw, l, k});
+                    }
+                }
+            }
+        }
+    }
+    else {
+        unordered_map<const Particle*, unsigned int> id(particles.size());
+        for (unsigned int i = 0; i < particles.size(); i++) {
+            id[particles[i]] = i;
+        }
+        for (SpringDamper* s : springDampers) {
+            springs.push_back({id[s->p1], id[s->p2], s->l, s->Ks});
+        }
+    }
+    projective = new ProjectiveSolver(springs, NUM_SAMPLE * TIME_STEP, gridStencil ? width : 0);
+}
+
+void Cloth::topologyChanged() {
+    updateNormals();
+    if (strainLimit > 0.0f) colorSprings();
+    if (projective) {
+        setProjective(false);
+        setProjective(true);
+    }
+    resizeBuffers();
+}
+
+void Cloth::setRemeshing(bool enabled) {
+    // the springs have to run along the triangles, as on loaded meshes; grid cloths keep their rows
+    if (enabled == (remesher != NULL) || (enabled && (gridStencil || bendStride != 0))) return;
+    delete remesher;
+    remesher = enabled ? new Remesher(this) : NULL;
+}
+
+void Cloth::handleCollision() {
+    if (!terrain) return;
+    terrain->handleCollision(particles, ELASTICITY, FRICTION, EPSILON);
+}
+
+float Cloth::getKineticEnergy() {
+    double energy = Parallel::reduce(particles.size(), PARALLEL_GRAIN, [this](size_t begin, size_t end) {
+        double sum = 0.0;
+        for (size_t i = begin; i < end; i++) {
+            sum += 0.5 * particles[i]->m * glm::dot(particles[i]->v, particles[i]->v);
+        }
+        return sum;
+    });
+    return (float) energy;
+}
+
+bool Cloth::reorder(ReorderMethod method) {
+    // the stencil relies on the row-major order, the remesher on its own
+    if (gridStencil || remesher || method == REORDER_NONE || method == ordering) return false;
+    
+    unordered_map<const Particle*, unsigned int> oldId(particles.size());
     for (unsigned int i = 0; i < particles.size(); i++) {
-        positions[i] = particles[i]->p;
+        oldId[particles[i]] = i;
+    }
+    
+    vector<unsigned int> order;
+    if (method == REORDER_MORTON) {
+        order = Reorder::morton(positions);
+    }
+    else {
+        vector<pair<unsigned int, unsigned int>> edges;
+        edges.reserve(springDampers.size());
+        for (SpringDamper* s : springDampers) {
+            edges.push_back(make_pair(oldId[s->p1], oldId[s->p2]));
+        }
+        order = Reorder::reverseCuthillMcKee((unsigned int) particles.size(), edges);
+    }
+    
+    // reallocate the particles in the new order so neighbours also share cache lines
+    vector<unsigned int> newId(particles.size());
+    vector<Particle*> moved(particles.size());
+    vector<glm::vec3> movedPositions(particles.size());
+    vector<unsigned int> movedOriginalId(particles.size());
+    arena.reserve(particles.size() * sizeof(Particle) + alignof(max_align_t));
+    for (unsigned int i = 0; i < order.size(); i++) {
+        newId[order[i]] = i;
+        moved[i] = arena.create<Particle>(*particles[order[i]]);
+        movedPositions[i] = positions[order[i]];
+        movedOriginalId[i] = originalId[order[i]];
+    }
+    
+    // springs and triangles follow their lowest particle, so the force pass sweeps memory once
+    vector<pair<unsigned int, SpringDamper*>> springKeys(springDampers.size());
+    for (unsigned int i = 0; i < springDampers.size(); i++) {
+        SpringDamper* s = springDampers[i];
+        unsigned int p1 = newId[oldId[s->p1]], p2 = newId[oldId[s->p2]];
+        s->p1 = moved[p1];
+        s->p2 = moved[p2];
+        springKeys[i] = make_pair(glm::min(p1, p2), s);
+    }
+    stable_sort(springKeys.begin(), springKeys.end(), [](const pair<unsigned int, SpringDamper*>& s, const pair<unsigned int, SpringDamper*>& t) {
+        return s.first < t.first;
+    });
+    for (unsigned int i = 0; i < springKeys.size(); i++) {
+        springDampers[i] = springKeys[i].second;
+    }
+    
+    vector<pair<unsigned int, unsigned int>> triangleKeys(triangles.size());
+    vector<unsigned int> triangleIds(3 * triangles.size());
+    for (unsigned int i = 0; i < triangles.size(); i++) {
+        Triangle* t = triangles[i];
+        unsigned int a = newId[oldId[t->a]], b = newId[oldId[t->b]], c = newId[oldId[t->c]];
+        t->a = moved[a];
+        t->b = moved[b];
+        t->c = moved[c];
+        triangleIds[3 * i] = a;
+        triangleIds[3 * i + 1] = b;
+        triangleIds[3 * i + 2] = c;
+        triangleKeys[i] = make_pair(glm::min(a, glm::min(b, c)), i);
+    }
+    stable_sort(triangleKeys.begin(), triangleKeys.end());
+    vector<Triangle*> sortedTriangles(triangles.size());
+    indices.clear();
+    for (unsigned int i = 0; i < triangleKeys.size(); i++) {
+        unsigned int slot = triangleKeys[i].second;
+        sortedTriangles[i] = triangles[slot];
+        indices.insert(indices.end(), {triangleIds[3 * slot], triangleIds[3 * slot + 1], triangleIds[3 * slot + 2]});
+    }
+    triangles = sortedTriangles;
+    for (unsigned int& id : fixedId) {
+        id = newId[id];
+    }
+    
+    // the old particles stay in the arena until the cloth is destroyed
+    particles = moved;
+    positions = movedPositions;
+    markDirty(dirtyPositions, 0, (unsigned int) positions.size());
+    originalId = movedOriginalId;
+    updateCurrentIds();
+    ordering = method;
+    
+    // the solver numbers particles by index
+    if (projective) {
+        setProjective(false);
+        setProjective(true);
+    }
+    
+    if (isUploaded()) {
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * indices.size(), indices.data(), GL_STATIC_DRAW);
+        glBindVertexArray(0);
+    }
+    else if (VAO) {
+        uploadedBytes = 0; // start the stream over with the new order
     }
     updateNormals();
     updateBuffers();
+    return true;
+}
+
+void Cloth::updateCurrentIds() {
+    currentId.assign(originalId.size(), 0);
+    bool identity = true;
+    for (unsigned int i = 0; i < originalId.size(); i++) {
+        currentId[originalId[i]] = i;
+        identity = identity && originalId[i] == i;
+    }
+    if (identity) currentId.clear();
+}
+
+void Cloth::getOriginalPositions(vector<glm::vec3>& out) {
+    out.resize(positions.size());
+    for (unsigned int i = 0; i < positions.size(); i++) {
+        out[originalId[i]] = positions[i];
+    }
 }
 
-void Cloth::handleCollision(Particle* particle) {
-    if (particle->p.y < groundHeight) {
-        particle->p.y = 2.0f * groundHeight - particle->p.y;
-        particle->v.y = -ELASTICITY * particle->v.y;
-        particle->v.x = (1.f - FRICTION) * particle->v.x;
-        particle->v.z = (1.f - FRICTION) * particle->v.z;
+float Cloth::getMeanEdgeSpan() {
+    vector<pair<unsigned int, unsigned int>> edges;
+    if (springDampers.empty()) {
+        for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+            edges.push_back(make_pair(indices[i], indices[i + 1]));
+            edges.push_back(make_pair(indices[i + 1], indices[i + 2]));
+            edges.push_back(make_pair(indices[i + 2], indices[i]));
+        }
+    }
+    else {
+        unordered_map<const Particle*, unsigned int> id(particles.size());
+        for (unsigned int i = 0; i < particles.size(); i++) {
+            id[particles[i]] = i;
+        }
+        for (SpringDamper* s : springDampers) {
+            edges.push_back(make_pair(id[s->p1], id[s->p2]));
+        }
     }
+    return Reorder::meanEdgeSpan(edges);
 }
 
 void Cloth::setFixedRow(int r) {
@@ -233,8 +1447,8 @@ void Cloth::setFixedRow(int r) {
     r = (height - 1) - r; // user counts the row from the top
     
     for (unsigned int i = r * width; i < r * width + width; i++) {
-        particles[i]->fixed = true;
-        fixedId.push_back(i);
+        particles[particleAt(i)]->fixed = true;
+        fixedId.push_back(particleAt(i));
     }
 }
 
@@ -242,8 +1456,8 @@ void Cloth::setFixedCol(int c) {
     if (c < 0 || c > width - 1) return;
     
     for (unsigned int i = c; i < particles.size(); i += width) {
-        particles[i]->fixed = true;
-        fixedId.push_back(i);
+        particles[particleAt(i)]->fixed = true;
+        fixedId.push_back(particleAt(i));
     }
 }
 
@@ -251,35 +1465,76 @@ glm::vec3 Cloth::setFixedPoint(int r, int c) {
     if (r < 0 || r > height - 1 || c < 0 || c > width - 1) return glm::vec3(0.0f);
     r = (height - 1) - r; // user counts the row from the top
     
-    particles[r * width + c]->fixed = true;
-    fixedId.push_back(r * width + c);
-    return particles[r * width + c]->p;
+    unsigned int id = particleAt(r * width + c);
+    particles[id]->fixed = true;
+    fixedId.push_back(id);
+    return particles[id]->p;
+}
+
+void Cloth::setFixedAbove(float y) {
+    for (unsigned int i = 0; i < particles.size(); i++) {
+        if (particles[i]->p.y >= y && !particles[i]->fixed) {
+            particles[i]->fixed = true;
+            fixedId.push_back(i);
+        }
+    }
 }
 
 void Cloth::translate(glm::vec3 offset) {
     for (unsigned int id : fixedId) {
+        if (gridStencil) wakeTileOf(id);
         particles[id]->p.x += offset.x;
         particles[id]->p.y += offset.y;
         particles[id]->p.z += offset.z;
         positions[id] = particles[id]->p;
+        markDirty(dirtyPositions, id, id + 1);
     }
     updateBuffers();
 }
 
-Cloth::~Cloth() {
-    for (Particle* p : particles) {
-        delete p;
-    }
-    for (SpringDamper* s : springDampers) {
-        delete s;
+void Cloth::reset() {
+    for (unsigned int i = 0; i < particles.size(); i++) {
+        particles[i]->p = restPositions[originalId[i]];
+        particles[i]->v = glm::vec3(0.0f);
+        particles[i]->f = glm::vec3(0.0f);
+        particles[i]->fixed = false;
+        positions[i] = particles[i]->p;
     }
-    for (Triangle* t : triangles) {
-        delete t;
+    markDirty(dirtyPositions, 0, (unsigned int) positions.size());
+    fixedId.clear();
+    wind = glm::vec3(0.0f);
+    windTime = 0.0f;
+    wakeTiles();
+    updateNormals();
+    updateBuffers();
+    previousKept = false; // nothing to move from
+}
+
+void Cloth::showFrame(const glm::vec3* framePositions) {
+    // frames are stored in build order, see getOriginalPositions
+    for (unsigned int i = 0; i < particles.size(); i++) {
+        particles[i]->p = framePositions[originalId[i]];
+        particles[i]->v = glm::vec3(0.0f);
+        positions[i] = particles[i]->p;
     }
+    markDirty(dirtyPositions, 0, (unsigned int) positions.size());
+    wakeTiles();
+    updateNormals();
+    keepPrevious();
+    updateBuffers();
+}
+
+Cloth::~Cloth() {
+    // particles, springs and triangles go with the arena, none of them owns anything
+    delete projective;
+    delete remesher;
     
-    // Delete the VBOs and the VAO.
+    // Delete the VBOs and the VAO, if the cloth ever got them.
+    if (!VAO) return;
     glDeleteBuffers(1, &VBO_positions);
     glDeleteBuffers(1, &VBO_normals);
+    glDeleteBuffers(1, &VBO_previousPositions);
+    glDeleteBuffers(1, &VBO_previousNormals);
     glDeleteBuffers(1, &EBO);
     glDeleteVertexArrays(1, &VAO);
 }
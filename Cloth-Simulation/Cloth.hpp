@@ -14,6 +14,12 @@
 #include "Object.hpp"
 #include "SpringDamper.hpp"
 #include "Triangle.hpp"
+#include "Terrain.hpp"
+#include "Reorder.hpp"
+#include "Arena.hpp"
+#include "WindField.hpp"
+#include "ProjectiveSolver.hpp"
+#include "Remesher.hpp"
 
 #define ELASTICITY      0.5f
 #define FRICTION        0.1f
@@ -24,56 +30,257 @@
 #define TIME_STEP       1.0f / 1200.0f
 #define AIR_DENSITY     1.225f
 #define DRAG            1.0f
-#define EPSILON         0.001f;
+#define EPSILON         0.001f
+#define BEND_STRIDE     2       // bend springs skip one particle
+#define BEND_CONST      0.0f    // stiffness of the bend springs, 0 leaves them out
+#define GRID_DIRECTIONS 4       // edge directions of the grid stencil per span
+#define TILE_SIZE       64      // particles per side of a tile, sized so a tile and its halo stay in L2
+#define TILE_SUBSTEPS   NUM_SAMPLE // substeps run on a tile before moving to the next
+#define SLEEP_SPEED     0.01f   // a tile is settled while its particles move slower than this on average (m/s)
+#define SLEEP_DRIFT     0.00005f // and none moves further per substep, above the bounce of resting contact (m)
+#define SLEEP_FRAMES    300     // frames a tile stays settled before it sleeps
+#define DIRTY_GAP       256     // unchanged particles between two changed ranges that are still sent in one call
+#define STRAIN_SWEEPS   4       // passes of the strain limit over the springs after each integration
+#define STRAIN_COLORS   64      // spring colours tracked per particle, springs beyond them are limited on one thread
+#define MULTIRATE_LEVELS 4      // step sizes of the multirate update, TIME_STEP times 1, 2, 4 and 8, as far as the substeps divide
+#define MULTIRATE_SAFETY 0.8f   // share of the explicit stability limit a tile may step with
+#define MULTIRATE_TRAVEL 0.1f   // largest move of a particle per step, as a fraction of the rest length
+#define MULTIRATE_STRAIN 0.25f  // stretch of a structural spring from which a tile keeps the smallest step
+#define MULTIRATE_CONTACT 2.0f  // rest lengths above the terrain from which a tile keeps the smallest step
 
 using namespace std;
 
+// a vector quantity per particle stored as one array per component,
+// so the stencil sweeps stream through memory and vectorise
+struct GridField {
+    vector<float> x, y, z;
+    
+    void resize(size_t n) {
+        x.assign(n, 0.0f);
+        y.assign(n, 0.0f);
+        z.assign(n, 0.0f);
+    }
+};
+
+// working set of one tile and its halo in the tiled update
+struct GridTile {
+    GridField p, v, f;
+    GridField edges[GRID_DIRECTIONS];
+    vector<float> m;
+    vector<unsigned char> fixed;
+    
+    // grow to hold n particles, a smaller block reuses the arrays
+    void fit(size_t n) {
+        if (m.size() >= n) return;
+        p.resize(n);
+        v.resize(n);
+        f.resize(n);
+        for (unsigned int d = 0; d < GRID_DIRECTIONS; d++) {
+            edges[d].resize(n);
+        }
+        m.assign(n, 0.0f);
+        fixed.assign(n, 0);
+    }
+};
+
 class Cloth : public Object {
 private:
+    friend class Checkpoint;
+    friend class ObjLoader;
+    friend class Remesher;
+    friend class Subspace;
     
     // buffers for rendering
     GLuint VAO;
     GLuint VBO_positions, VBO_normals, EBO;
+    GLuint VBO_previousPositions, VBO_previousNormals;  // state before the last step, copied on the GPU
+    size_t uploadedBytes;   // of positions, normals and indices, sent in that order
+    bool previousKept;      // the previous buffers hold the step before the one uploaded
+    float blend;            // share of the way from the previous step to the current one drawn
+    vector<pair<unsigned int, unsigned int>> dirtyPositions;   // particle ranges changed since the last upload
+    vector<pair<unsigned int, unsigned int>> dirtyNormals;
     
     vector<glm::vec3> positions;
     vector<glm::vec3> normals;
     vector<unsigned int> indices;
     
+    Arena arena;            // owns every particle, spring and triangle, freed in one go
     vector<Particle*> particles;
     vector<SpringDamper*> springDampers;
     vector<Triangle*> triangles;
     vector<unsigned int> fixedId;
+    vector<unsigned int> originalId;    // index each particle had when the cloth was built
+    vector<unsigned int> currentId;     // inverse of originalId, empty while the build order is kept
+    vector<glm::vec3> restPositions;    // in build order, restored by reset
+    ReorderMethod ordering;             // last order applied by reorder
     
     unsigned int width;     // number of particles on x axis
     unsigned int height;    // number of particles on y axis
     float offset;           // offset between two particles positions
     float totalMass;        // total mass of the cloth
     glm::vec3 wind;         // wind that creates aero dynamics
-    float groundHeight;     // the height of the ground
+    Terrain* terrain;       // the ground the cloth collides with, not owned
+    
+    // turbulence around the mean wind, not owned; NULL blows the same wind on every triangle
+    WindField* windField;
+    float windTime;         // simulated time the field is sampled at
+    GridField windAt;       // particle positions the field is looked up at, once a frame
+    GridField particleWind;
+    GridField triangleWind; // mean of the wind at the corners of each triangle
+    
+    // matrix-free grid path: spring forces come from a stencil over row-major
+    // arrays instead of one SpringDamper per edge
+    bool gridStencil;
+    float Ks, Kd;               // structural and shear springs
+    unsigned int bendStride;    // span of the bend springs in particles
+    float bendKs;               // bend stiffness, 0 leaves them out
+    GridField gridP;            // positions and velocities gathered for the stencil
+    GridField gridV;
+    GridField gridF;            // summed spring force per particle
+    GridField gridEdges[GRID_DIRECTIONS]; // force of the edge leaving each particle in one direction
+    
+    // tiled update of grid cloths: the state after a pass goes to the next arrays
+    bool tiled;
+    GridField nextP;
+    GridField nextV;
+    vector<float> gridM;
+    vector<unsigned char> gridFixed;
+    vector<GridTile> tileScratch;   // working sets, one per range of tiles, kept between frames
+    
+    // sleeping tiles are neither simulated nor moved until something disturbs them
+    bool sleeping;
+    vector<unsigned char> tileAsleep;
+    vector<unsigned char> tileCalm;         // settled through every pass of this frame
+    vector<unsigned int> tileCalmFrames;    // frames in a row the tile has been settled
+    
+    // multirate tiles step with TIME_STEP << tileLevel[t], as large as their springs, speed and surroundings allow
+    bool multirate;
+    vector<unsigned char> tileLevel;
+    
+    // strain limiting: after each integration, springs stretched by more than strainLimit of
+    // their rest length are shortened, one colour of springs that share no particle at a time
+    float strainLimit;                      // 0 leaves the springs free
+    vector<SpringDamper*> limitedSprings;   // stretch springs of cloths with spring objects, by colour
+    vector<size_t> colorStart;              // colour c is [colorStart[c], colorStart[c + 1]) of limitedSprings
+    
+    // implicit integration by Projective Dynamics, one step per frame; NULL integrates explicitly
+    ProjectiveSolver* projective;
+    
+    // adaptive remeshing of cloths built from triangles; NULL keeps the topology
+    Remesher* remesher;
+    
+    // size the arena and the topology arrays once so building allocates only a few blocks
+    void reserveTopology(size_t particleCount, size_t springCount, size_t triangleCount);
+    
+    size_t gridSpringCount(unsigned int span);
+    
+    // current index of the particle built at buildId
+    unsigned int particleAt(unsigned int buildId) { return currentId.empty() ? buildId : currentId[buildId]; }
+    
+    void updateCurrentIds();
     
     void initParticles(bool verticalLayout);
     
-    void initSpringDampers(unsigned int numBetween, float Ks, float Kd);
+    void initSpringDampers(unsigned int numBetween, float Ks, float Kd, bool stretch);
     
     void initTriangles();
     
+    void initGridArrays();
+    
+    void applyGridForces();
+    
+    // spring force of every edge leaving rows [rowBegin, rowEnd) of a cols x rows block
+    void computeGridEdges(const GridField& p, const GridField& v, GridField* edges,
+                          unsigned int cols, unsigned int rows,
+                          unsigned int rowBegin, unsigned int rowEnd, unsigned int span);
+    
+    // sum the edge forces per particle of those rows
+    void gatherGridEdges(const GridField* edges, GridField& f, unsigned int cols,
+                         unsigned int rowBegin, unsigned int rowEnd, unsigned int span);
+    
+    void updateTiled();
+    
+    // true if the tile interior settled during the substeps, taken level by level steps of TIME_STEP << level
+    bool updateTile(GridTile& tile, unsigned int tileRow, unsigned int tileCol, unsigned int substeps, unsigned int level);
+    
+    // step level of every tile for the coming frame; neighbouring tiles differ by one level at most
+    void assignTileLevels(unsigned int tileRows, unsigned int tileCols, unsigned int substeps);
+    
+    // carry a sleeping tile over to the next arrays unchanged
+    void holdTile(unsigned int tileRow, unsigned int tileCol);
+    
+    // put tiles that stayed settled to sleep and wake the neighbours of moving ones
+    void settleTiles(unsigned int tileRows, unsigned int tileCols);
+    
+    void wakeTiles();
+    
+    // wake the tile holding a particle of a grid cloth
+    void wakeTileOf(unsigned int id);
+    
+    // group the stretch springs into colours whose springs share no particle
+    void colorSprings();
+    
+    void limitSpringStrain();
+    
+    // shorten the stretch edges of a cols x rows grid after a step of deltaTime, a colour at a time over threads
+    void limitGridStrain(GridField& p, GridField& v, const float* m, const unsigned char* fixed,
+                         unsigned int cols, unsigned int rows, float deltaTime);
+    
+    // one colour: the edges in direction d starting in rows [rowBegin, rowEnd), every second row or column
+    void limitGridEdges(GridField& p, GridField& v, const float* m, const unsigned char* fixed,
+                        unsigned int cols, unsigned int rows, float deltaTime, unsigned int d, unsigned int parity,
+                        unsigned int rowBegin, unsigned int rowEnd);
+    
+    void applyGridAero(GridTile& tile, unsigned int a, unsigned int b, unsigned int c, const glm::vec3& vair);
+    
+    void applyAeroForces();
+    
+    // look up the wind field for every triangle of the coming frame
+    void sampleWind();
+    
     void updateNormals();
     
     void initBuffers();
     
+    // new storage for buffers whose arrays changed size, sent whole by the next uploads
+    void resizeBuffers();
+    
+    size_t getBufferBytes();
+    
     void updateBuffers();
     
-    void handleCollision(Particle* particle);
+    // copy the uploaded state to the previous buffers before the next step replaces it
+    void keepPrevious();
+    
+    void markDirty(vector<pair<unsigned int, unsigned int>>& ranges, unsigned int begin, unsigned int end);
+    
+    void uploadRanges(GLuint buffer, const vector<glm::vec3>& data, vector<pair<unsigned int, unsigned int>>& ranges);
+    
+    void updateProjective();
+    
+    // bring everything built on the springs and particles up to a new topology
+    void topologyChanged();
+    
+    void handleCollision();
     
 public:
     
     Cloth();
     
     Cloth(unsigned int height, unsigned int width, float offset,
-          float totalMass, glm::vec3 color, bool verticalLayOut);
+          float totalMass, glm::vec3 color, bool verticalLayOut, bool gridStencil = true);
     
     void draw(const glm::mat4& viewProjMtx, GLuint shader);
     
+    // drawn between the last two steps in the vertex shader, the current step alone until two are uploaded;
+    // the state before a step is only kept while the last blend set is below 1
+    void setBlend(float alpha);
+    
+    // create the GPU buffers on the first call and send at most budget bytes per call; true once all are resident
+    bool uploadBuffers(size_t budget);
+    
+    bool isUploaded();
+    
     void update();
     
     void setFixedRow(int r);
@@ -82,14 +289,72 @@ public:
     
     glm::vec3 setFixedPoint(int r, int c);
     
+    // fix every particle at or above height y
+    void setFixedAbove(float y);
+    
     void translate(glm::vec3 offset);
     
-    void setGroundHeight(float height) { this->groundHeight = height + EPSILON; }
+    // back to the rest state with nothing fixed and no wind, keeping the topology and GPU buffers
+    void reset();
+    
+    // display externally computed positions in build order (e.g. a played back cache) instead of simulating
+    void showFrame(const glm::vec3* framePositions);
+    
+    void setTerrain(Terrain* terrain) { this->terrain = terrain; }
+    
+    // run grid cloths tile by tile, ignored for cloths with spring objects
+    void setTiled(bool tiled) { this->tiled = tiled; }
     
-    void setWind(glm::vec3 wind) { this->wind = wind; };
+    // let settled tiles sleep, only used by the tiled update
+    void setSleeping(bool sleeping);
+    
+    unsigned int getSleepingTiles();
+    
+    // step tiles with larger steps where the cloth is calm, only used by the tiled update
+    void setMultirate(bool multirate) { this->multirate = multirate; }
+    
+    // tiles stepping with more than TIME_STEP in the last frame
+    unsigned int getCoarseTiles();
+    
+    // tiles of the tiled update, 0 for cloths with spring objects
+    unsigned int getTileCount();
+    
+    // largest stretch of the structural and shear springs as a fraction of their rest length, 0 for none
+    void setStrainLimit(float limit);
+    
+    // integrate with Projective Dynamics instead of explicit substeps; the system is factored on the first step
+    void setProjective(bool enabled);
+    
+    // split and collapse edges where the cloth bends, ignored for grid cloths
+    void setRemeshing(bool enabled);
+    
+    bool isRemeshing() { return remesher != NULL; }
+    
+    void setWind(glm::vec3 wind) {
+        if (wind != this->wind) wakeTiles();
+        this->wind = wind;
+    };
     
     glm::vec3 getWind() { return wind; };
     
+    // blow turbulent wind around the mean wind, NULL for uniform wind
+    void setWindField(WindField* windField) { this->windField = windField; }
+    
+    WindField* getWindField() { return windField; }
+    
+    const vector<glm::vec3>& getPositions() { return positions; }
+    
+    // permute particles, springs and triangles for memory locality; grid cloths keep their row-major order
+    bool reorder(ReorderMethod method);
+    
+    // positions in the order the cloth was built in, for output that has to match the source
+    void getOriginalPositions(vector<glm::vec3>& out);
+    
+    // mean index distance between the ends of the springs, or of the triangle edges of grid cloths
+    float getMeanEdgeSpan();
+    
+    float getKineticEnergy();
+    
     ~Cloth();
 };
 
@@ -0,0 +1,33 @@
+//
+//  ClothCache.cpp
+//
+
+#include "ClothCache.hpp"
+
+Cloth* ClothCache::acquire(unsigned int width, unsigned int height, ClothLayout layout, bool gridStencil) {
+    auto found = cloths.find(Key(width, height, layout, gridStencil));
+    if (found == cloths.end()) return NULL;
+    
+    found->second->reset();
+    return found->second;
+}
+
+void ClothCache::store(unsigned int width, unsigned int height, ClothLayout layout, bool gridStencil, Cloth* cloth) {
+    Cloth*& slot = cloths[Key(width, height, layout, gridStencil)];
+    if (slot && slot != cloth) delete slot;
+    slot = cloth;
+}
+
+bool ClothCache::contains(const Object* object) {
+    for (const pair<const Key, Cloth*>& entry : cloths) {
+        if (entry.second == object) return true;
+    }
+    return false;
+}
+
+void ClothCache::clear() {
+    for (const pair<const Key, Cloth*>& entry : cloths) {
+        delete entry.second;
+    }
+    cloths.clear();
+}
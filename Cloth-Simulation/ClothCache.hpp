@@ -0,0 +1,44 @@
+//
+//  ClothCache.hpp
+//
+
+#ifndef ClothCache_hpp
+#define ClothCache_hpp
+
+#include <stdio.h>
+#include <map>
+#include <tuple>
+
+#include "Cloth.hpp"
+
+using namespace std;
+
+enum ClothLayout {
+    LAYOUT_VERTICAL,
+    LAYOUT_HORIZONTAL,
+    LAYOUT_MESH         // loaded from the OBJ file, one per run
+};
+
+// Cloths of earlier scenes, kept with their particles, springs, triangles and
+// GPU buffers. Switching back to a scene with the same shape only resets the
+// cached cloth to its rest state instead of building it again.
+class ClothCache {
+private:
+    // width, height, layout, grid stencil
+    typedef tuple<unsigned int, unsigned int, int, bool> Key;
+    map<Key, Cloth*> cloths;
+
+public:
+    // the cloth of this shape reset to rest, NULL if there is none yet
+    Cloth* acquire(unsigned int width, unsigned int height, ClothLayout layout, bool gridStencil);
+
+    // take ownership of a newly built cloth
+    void store(unsigned int width, unsigned int height, ClothLayout layout, bool gridStencil, Cloth* cloth);
+
+    bool contains(const Object* object);
+
+    // delete every cached cloth, needs the GL context
+    void clear();
+};
+
+#endif /* ClothCache_hpp */
@@ -0,0 +1,125 @@
+//
+//  FrameCodec.cpp
+//
+
+#include "FrameCodec.hpp"
+
+#include <math.h>
+#include <string.h>
+#include <zlib.h>
+
+static inline uint32_t zigzag(int32_t v) {
+    return ((uint32_t) v << 1) ^ (uint32_t) (v >> 31);
+}
+
+static inline int32_t unzigzag(uint32_t v) {
+    return (int32_t) (v >> 1) ^ -(int32_t) (v & 1);
+}
+
+FrameCodec::FrameCodec(unsigned int numParticles, float maxError) {
+    this->numParticles = numParticles;
+    this->step = 2.0f * maxError;
+    this->origin = glm::vec3(0.0f);
+    this->history = vector<int32_t>(3 * numParticles, 0);
+    this->primed = false;
+}
+
+bool FrameCodec::encode(const glm::vec3* positions, bool keyframe, vector<unsigned char>& out) {
+    keyframe = keyframe || !primed;
+
+    if (keyframe) {
+        // anchor the quantisation grid at the bounds of this frame
+        origin = positions[0];
+        for (unsigned int i = 1; i < numParticles; i++) {
+            origin = glm::min(origin, positions[i]);
+        }
+    }
+
+    // zigzag varint residuals, one plane per component so similar bytes stay together
+    residuals.resize(3 * 5 * (size_t) numParticles);
+    unsigned char* w = residuals.data();
+    float invStep = 1.0f / step;
+    for (unsigned int c = 0; c < 3; c++) {
+        int32_t* prev = &history[c * numParticles];
+        int32_t last = 0;
+        for (unsigned int i = 0; i < numParticles; i++) {
+            int32_t q = (int32_t) lroundf((positions[i][c] - origin[c]) * invStep);
+            int32_t predicted = keyframe ? last : prev[i];
+            uint32_t r = zigzag(q - predicted);
+            while (r >= 0x80) {
+                *w++ = (unsigned char) (r | 0x80);
+                r >>= 7;
+            }
+            *w++ = (unsigned char) r;
+            prev[i] = last = q;
+        }
+    }
+    uLong rawSize = (uLong) (w - residuals.data());
+    primed = true;
+
+    CacheFrameHeader header;
+    memset(&header, 0, sizeof(header));
+    header.rawSize = (uint32_t) rawSize;
+    header.keyframe = keyframe ? 1 : 0;
+    header.step = step;
+    header.origin[0] = origin.x;
+    header.origin[1] = origin.y;
+    header.origin[2] = origin.z;
+
+    size_t start = out.size();
+    uLongf payloadSize = compressBound(rawSize);
+    out.resize(start + sizeof(header) + payloadSize);
+    if (compress2(&out[start + sizeof(header)], &payloadSize, residuals.data(), rawSize, Z_BEST_SPEED) != Z_OK) {
+        out.resize(start);
+        return false;
+    }
+    header.payloadSize = (uint32_t) payloadSize;
+    memcpy(&out[start], &header, sizeof(header));
+    out.resize(start + sizeof(header) + payloadSize);
+    return true;
+}
+
+bool FrameCodec::decode(const unsigned char* block, size_t size, glm::vec3* positions) {
+    if (size < sizeof(CacheFrameHeader)) return false;
+    CacheFrameHeader header;
+    memcpy(&header, block, sizeof(header));
+    if (sizeof(header) + header.payloadSize > size) return false;
+    if (!header.keyframe && !primed) return false;
+
+    residuals.resize(header.rawSize);
+    uLongf rawSize = header.rawSize;
+    if (uncompress(residuals.data(), &rawSize, block + sizeof(header), header.payloadSize) != Z_OK
+        || rawSize != header.rawSize) {
+        primed = false;
+        return false;
+    }
+
+    const unsigned char* r = residuals.data();
+    const unsigned char* end = r + rawSize;
+    glm::vec3 frameOrigin(header.origin[0], header.origin[1], header.origin[2]);
+    for (unsigned int c = 0; c < 3; c++) {
+        int32_t* prev = &history[c * numParticles];
+        int32_t last = 0;
+        for (unsigned int i = 0; i < numParticles; i++) {
+            uint32_t v = 0;
+            unsigned int shift = 0;
+            while (r < end && (*r & 0x80) && shift < 28) {
+                v |= (uint32_t) (*r++ & 0x7f) << shift;
+                shift += 7;
+            }
+            if (r == end) {
+                primed = false;
+                return false;
+            }
+            v |= (uint32_t) *r++ << shift;
+
+            int32_t q = (header.keyframe ? last : prev[i]) + unzigzag(v);
+            prev[i] = last = q;
+            positions[i][c] = frameOrigin[c] + q * header.step;
+        }
+    }
+    primed = true;
+    return true;
+}
+
+FrameCodec::~FrameCodec() {}
@@ -0,0 +1,83 @@
+//
+//  FrameCodec.hpp
+//
+
+#ifndef FrameCodec_hpp
+#define FrameCodec_hpp
+
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+
+#include "Core.h"
+
+#define CACHE_MAGIC         0x48434c43u // "CLCH" in little endian
+#define CACHE_VERSION       1u
+#define CACHE_KEY_INTERVAL  32          // a keyframe every this many frames bounds seek cost
+
+using namespace std;
+
+// A cache file is a CacheHeader, then one block per frame (CacheFrameHeader
+// followed by its compressed payload), then the frame index and a CacheFooter.
+struct CacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t numParticles;
+    uint32_t scene;             // scene the frames were recorded from
+    float frameTime;            // simulated seconds between two frames
+    float maxError;             // quantisation error bound per coordinate
+    uint32_t keyInterval;
+    uint32_t reserved;
+};
+
+struct CacheFrameHeader {
+    uint32_t payloadSize;       // compressed bytes following this header
+    uint32_t rawSize;           // bytes of the residual stream before compression
+    uint32_t keyframe;          // 1 if the frame decodes without its predecessor
+    float step;                 // quantisation step
+    float origin[3];            // quantisation origin, the bounds minimum of the last keyframe
+    uint32_t reserved;
+};
+
+struct CacheIndexEntry {
+    uint64_t offset;            // file offset of the CacheFrameHeader
+    uint32_t size;              // header plus payload bytes
+    uint32_t keyframe;
+};
+
+struct CacheFooter {
+    uint64_t indexOffset;
+    uint32_t numFrames;
+    uint32_t magic;
+};
+
+// Quantises positions on a grid anchored at the keyframe bounds, predicts each
+// frame from the previous one (keyframes from the previous particle), and
+// compresses the zigzag varint residuals. Encoder and decoder keep the same
+// integer history, so error never accumulates across delta frames.
+class FrameCodec {
+private:
+    unsigned int numParticles;
+    float step;
+    glm::vec3 origin;
+    vector<int32_t> history;    // quantised positions of the previous frame, per component
+    bool primed;                // history holds a frame
+
+    vector<unsigned char> residuals;
+
+public:
+    FrameCodec(unsigned int numParticles, float maxError);
+
+    // append the encoded frame (header and payload) to out
+    bool encode(const glm::vec3* positions, bool keyframe, vector<unsigned char>& out);
+
+    // decode one block produced by encode, false if it is corrupt or needs a missing predecessor
+    bool decode(const unsigned char* block, size_t size, glm::vec3* positions);
+
+    // forget history so the next decode has to start at a keyframe
+    void reset() { primed = false; }
+
+    ~FrameCodec();
+};
+
+#endif /* FrameCodec_hpp */
@@ -0,0 +1,90 @@
+//
+//  Hud.cpp
+//
+
+#include "Hud.hpp"
+
+static const glm::vec3 phaseColors[NUM_PHASES] = {
+    glm::vec3(0.90f, 0.30f, 0.20f), // springs
+    glm::vec3(0.20f, 0.60f, 0.90f), // aero
+    glm::vec3(0.30f, 0.80f, 0.30f), // integrate
+    glm::vec3(0.75f, 0.85f, 0.35f), // strain
+    glm::vec3(0.90f, 0.70f, 0.10f), // collision
+    glm::vec3(0.85f, 0.45f, 0.60f), // tiles
+    glm::vec3(0.60f, 0.40f, 0.80f), // normals
+    glm::vec3(0.95f, 0.55f, 0.25f), // remesh
+    glm::vec3(0.10f, 0.70f, 0.70f), // upload
+    glm::vec3(0.50f, 0.50f, 0.50f), // idle
+    glm::vec3(0.35f, 0.35f, 0.35f), // display
+    glm::vec3(0.10f, 0.10f, 0.10f), // frame
+};
+
+Hud::Hud(GLuint shader) {
+    this->shader = shader;
+
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat), 0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat), (void*) (2 * sizeof(GLfloat)));
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
+void Hud::addQuad(float x0, float y0, float x1, float y1, glm::vec3 color) {
+    float corners[6][2] = {{x0, y0}, {x1, y0}, {x1, y1}, {x0, y0}, {x1, y1}, {x0, y1}};
+    for (unsigned int i = 0; i < 6; i++) {
+        vertices.insert(vertices.end(), {corners[i][0], corners[i][1], color.x, color.y, color.z});
+    }
+}
+
+void Hud::draw() {
+    const float left = -0.95f, right = -0.35f, top = 0.95f;
+    const float rowHeight = 0.04f, barHeight = 0.028f;
+    const float scale = (right - left) / HUD_BUDGET_MS;
+
+    vertices.clear();
+    for (unsigned int i = 0; i < NUM_PHASES; i++) {
+        ProfilePhase phase = (ProfilePhase) i;
+        float y1 = top - i * rowHeight;
+        float y0 = y1 - barHeight;
+        float p50 = glm::min(Profiler::getPercentile(phase, 0.5f), HUD_BUDGET_MS);
+        float p95 = glm::min(Profiler::getPercentile(phase, 0.95f), HUD_BUDGET_MS);
+
+        addQuad(left, y0, right, y1, glm::vec3(0.9f));
+        addQuad(left, y0, left + p50 * scale, y1, phaseColors[i]);
+        addQuad(left + p95 * scale - 0.004f, y0, left + p95 * scale, y1, glm::vec3(0.0f));
+    }
+
+    glDisable(GL_DEPTH_TEST);
+    glUseProgram(shader);
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * vertices.size(), vertices.data(), GL_STREAM_DRAW);
+    glDrawArrays(GL_TRIANGLES, 0, (GLsizei) (vertices.size() / 5));
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+    glUseProgram(0);
+    glEnable(GL_DEPTH_TEST);
+}
+
+string Hud::getSummary() {
+    string summary;
+    char entry[64];
+    for (unsigned int i = 0; i < NUM_PHASES; i++) {
+        ProfilePhase phase = (ProfilePhase) i;
+        snprintf(entry, sizeof(entry), "%s%s %.2f/%.2f", i ? " | " : "", Profiler::getName(phase),
+                 Profiler::getPercentile(phase, 0.5f), Profiler::getPercentile(phase, 0.95f));
+        summary += entry;
+    }
+    return summary + " ms (p50/p95)";
+}
+
+Hud::~Hud() {
+    glDeleteBuffers(1, &VBO);
+    glDeleteVertexArrays(1, &VAO);
+}
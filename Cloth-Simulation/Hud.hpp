@@ -0,0 +1,41 @@
+//
+//  Hud.hpp
+//
+
+#ifndef Hud_hpp
+#define Hud_hpp
+
+#include <stdio.h>
+#include <string>
+
+#include "Core.h"
+#include "Profiler.hpp"
+
+#define HUD_BUDGET_MS   16.7f   // frame budget that spans the full bar width
+
+using namespace std;
+
+// Overlay with one bar per profiled phase: the bar is the median time of the
+// phase over the rolling window and the marker its 95th percentile.
+class Hud {
+private:
+    GLuint VAO;
+    GLuint VBO;
+    GLuint shader;
+
+    vector<float> vertices;     // interleaved x, y, r, g, b
+
+    void addQuad(float x0, float y0, float x1, float y1, glm::vec3 color);
+
+public:
+    Hud(GLuint shader);
+
+    void draw();
+
+    // one line summary of the percentiles, e.g. for the window title
+    string getSummary();
+
+    ~Hud();
+};
+
+#endif /* Hud_hpp */
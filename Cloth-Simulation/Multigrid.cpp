@@ -0,0 +1,253 @@
+//
+//  Multigrid.cpp
+//
+
+#include "Multigrid.hpp"
+#include "Parallel.hpp"
+
+#include <stdlib.h>
+
+Multigrid::Multigrid(unsigned int width, unsigned int height) {
+    // the coarse point c sits on fine point 2c; one more than half keeps a coarse point past an even edge,
+    // so the interpolation weights of every fine point add up to one
+    while (true) {
+        levels.push_back(Level());
+        allocate(levels.back(), width, height);
+        if (width <= MG_COARSEST || height <= MG_COARSEST) break;
+        width = width / 2 + 1;
+        height = height / 2 + 1;
+    }
+}
+
+void Multigrid::allocate(Level& level, unsigned int width, unsigned int height) {
+    level.width = width;
+    level.height = height;
+    level.pitch = width + 2 * MG_RADIUS;
+    size_t size = (size_t) level.pitch * (height + 2 * MG_RADIUS);
+    for (unsigned int s = 0; s < MG_STENCIL; s++) {
+        level.stencil[s].assign(size, 0.0f);
+    }
+    level.invDiagonal.assign(size, 0.0f);
+    level.weight.assign(size, 1.0f);
+    for (unsigned int c = 0; c < 3; c++) {
+        level.x[c].assign(size, 0.0f);
+        level.b[c].assign(size, 0.0f);
+        level.r[c].assign(size, 0.0f);
+    }
+}
+
+bool Multigrid::assemble(const vector<double>& diagonal, const vector<ProjectiveSpring>& springs,
+                         const vector<unsigned char>& pinned) {
+    Level& fine = levels[0];
+    const unsigned int center = MG_STENCIL / 2;
+    for (unsigned int s = 0; s < MG_STENCIL; s++) {
+        fine.stencil[s].assign(fine.stencil[s].size(), 0.0f);
+    }
+    for (unsigned int i = 0; i < fine.width * fine.height; i++) {
+        size_t k = fine.at(i % fine.width, i / fine.width);
+        fine.stencil[center][k] = (float) diagonal[i];
+        fine.weight[k] = pinned[i] ? 0.0f : 1.0f;
+    }
+
+    for (const ProjectiveSpring& spring : springs) {
+        int ax = spring.a % fine.width, ay = spring.a / fine.width;
+        int bx = spring.b % fine.width, by = spring.b / fine.width;
+        int dx = bx - ax, dy = by - ay;
+        if (abs(dx) > MG_RADIUS || abs(dy) > MG_RADIUS) return false;
+        size_t ka = fine.at(ax, ay), kb = fine.at(bx, by);
+        if (!pinned[spring.a]) fine.stencil[center][ka] += spring.k;
+        if (!pinned[spring.b]) fine.stencil[center][kb] += spring.k;
+        if (!pinned[spring.a] && !pinned[spring.b]) {
+            fine.stencil[center + dy * (2 * MG_RADIUS + 1) + dx][ka] -= spring.k;
+            fine.stencil[center - dy * (2 * MG_RADIUS + 1) - dx][kb] -= spring.k;
+        }
+    }
+
+    for (unsigned int l = 0; l < levels.size(); l++) {
+        if (l > 0) coarsen(l);
+        Level& level = levels[l];
+        for (size_t k = 0; k < level.invDiagonal.size(); k++) {
+            float d = level.stencil[center][k];
+            level.invDiagonal[k] = d > 0.0f ? 1.0f / d : 0.0f;
+        }
+    }
+    return true;
+}
+
+void Multigrid::coarsen(unsigned int l) {
+    const Level& fine = levels[l - 1];
+    Level& coarse = levels[l];
+    const int span = 2 * MG_RADIUS + 1;
+
+    Parallel::forRange(coarse.height, PARALLEL_GRAIN / coarse.width + 1, [&fine, &coarse, span](size_t begin, size_t end) {
+        for (unsigned int cy = (unsigned int) begin; cy < end; cy++) {
+            for (unsigned int cx = 0; cx < coarse.width; cx++) {
+                float sum[MG_STENCIL] = {};
+
+                // every fine point i this coarse point interpolates to, through the fine operator to its
+                // neighbours j, and back to the coarse points j interpolates from
+                for (int iy = 2 * (int) cy - 1; iy <= 2 * (int) cy + 1; iy++) {
+                    if (iy < 0 || iy >= (int) fine.height) continue;
+                    for (int ix = 2 * (int) cx - 1; ix <= 2 * (int) cx + 1; ix++) {
+                        if (ix < 0 || ix >= (int) fine.width) continue;
+                        size_t i = fine.at(ix, iy);
+                        float wi = fine.weight[i] * (ix == 2 * (int) cx ? 1.0f : 0.5f) * (iy == 2 * (int) cy ? 1.0f : 0.5f);
+                        if (wi == 0.0f) continue;
+
+                        for (int s = 0; s < MG_STENCIL; s++) {
+                            int jx = ix + s % span - MG_RADIUS, jy = iy + s / span - MG_RADIUS;
+                            float a = fine.stencil[s][i];
+                            if (a == 0.0f) continue;
+                            float wa = wi * a * fine.weight[fine.at(jx, jy)];
+
+                            // one parent per axis on an even fine point, two halves on an odd one
+                            for (int py = jy / 2; py <= (jy + 1) / 2; py++) {
+                                float wy = jy % 2 == 0 ? 1.0f : 0.5f;
+                                for (int px = jx / 2; px <= (jx + 1) / 2; px++) {
+                                    float wx = jx % 2 == 0 ? 1.0f : 0.5f;
+                                    int o = (py - (int) cy + MG_RADIUS) * span + px - (int) cx + MG_RADIUS;
+                                    sum[o] += wa * wx * wy;
+                                }
+                            }
+                        }
+                    }
+                }
+
+                size_t k = coarse.at(cx, cy);
+                for (unsigned int s = 0; s < MG_STENCIL; s++) {
+                    coarse.stencil[s][k] = sum[s];
+                }
+                // a coarse point over pinned points alone is cut off, give it a row of its own
+                if (sum[MG_STENCIL / 2] == 0.0f) coarse.stencil[MG_STENCIL / 2][k] = 1.0f;
+            }
+        }
+    });
+}
+
+void Multigrid::residual(Level& level) {
+    const int span = 2 * MG_RADIUS + 1;
+    ptrdiff_t offset[MG_STENCIL];
+    for (int s = 0; s < MG_STENCIL; s++) {
+        offset[s] = (ptrdiff_t) (s / span - MG_RADIUS) * level.pitch + s % span - MG_RADIUS;
+    }
+
+    Parallel::forRange(level.height, PARALLEL_GRAIN / level.width + 1, [&level, &offset](size_t begin, size_t end) {
+        for (unsigned int y = (unsigned int) begin; y < end; y++) {
+            size_t row = level.at(0, y);
+            for (unsigned int c = 0; c < 3; c++) {
+                const float* __restrict x = level.x[c].data();
+                const float* __restrict b = level.b[c].data() + row;
+                float* __restrict r = level.r[c].data() + row;
+                for (unsigned int i = 0; i < level.width; i++) {
+                    r[i] = b[i];
+                }
+                // one offset at a time, so the inner loop runs along a row and vectorizes
+                for (unsigned int s = 0; s < MG_STENCIL; s++) {
+                    const float* __restrict a = level.stencil[s].data() + row;
+                    const float* __restrict xs = x + row + offset[s];
+                    for (unsigned int i = 0; i < level.width; i++) {
+                        r[i] -= a[i] * xs[i];
+                    }
+                }
+            }
+        }
+    });
+}
+
+void Multigrid::smooth(Level& level, unsigned int sweeps) {
+    for (unsigned int sweep = 0; sweep < sweeps; sweep++) {
+        residual(level);
+        Parallel::forRange(level.height, PARALLEL_GRAIN / level.width + 1, [&level](size_t begin, size_t end) {
+            for (unsigned int y = (unsigned int) begin; y < end; y++) {
+                size_t row = level.at(0, y);
+                const float* __restrict d = level.invDiagonal.data() + row;
+                for (unsigned int c = 0; c < 3; c++) {
+                    float* __restrict x = level.x[c].data() + row;
+                    const float* __restrict r = level.r[c].data() + row;
+                    for (unsigned int i = 0; i < level.width; i++) {
+                        x[i] += MG_OMEGA * d[i] * r[i];
+                    }
+                }
+            }
+        });
+    }
+}
+
+void Multigrid::cycle(unsigned int l) {
+    Level& level = levels[l];
+    if (l + 1 == levels.size()) {
+        smooth(level, MG_COARSE_SWEEPS);
+        return;
+    }
+    smooth(level, MG_SWEEPS);
+    residual(level);
+
+    // restrict: each coarse point gathers the residual of the fine points it interpolates to
+    Level& coarse = levels[l + 1];
+    for (unsigned int c = 0; c < 3; c++) {
+        coarse.x[c].assign(coarse.x[c].size(), 0.0f);
+    }
+    Parallel::forRange(coarse.height, PARALLEL_GRAIN / coarse.width + 1, [&level, &coarse](size_t begin, size_t end) {
+        for (unsigned int cy = (unsigned int) begin; cy < end; cy++) {
+            for (unsigned int cx = 0; cx < coarse.width; cx++) {
+                float sum[3] = {};
+                for (int iy = 2 * (int) cy - 1; iy <= 2 * (int) cy + 1; iy++) {
+                    if (iy < 0 || iy >= (int) level.height) continue;
+                    for (int ix = 2 * (int) cx - 1; ix <= 2 * (int) cx + 1; ix++) {
+                        if (ix < 0 || ix >= (int) level.width) continue;
+                        size_t i = level.at(ix, iy);
+                        float w = level.weight[i] * (ix == 2 * (int) cx ? 1.0f : 0.5f) * (iy == 2 * (int) cy ? 1.0f : 0.5f);
+                        for (unsigned int c = 0; c < 3; c++) {
+                            sum[c] += w * level.r[c][i];
+                        }
+                    }
+                }
+                size_t k = coarse.at(cx, cy);
+                for (unsigned int c = 0; c < 3; c++) {
+                    coarse.b[c][k] = sum[c];
+                }
+            }
+        }
+    });
+
+    cycle(l + 1);
+
+    // prolong: each fine point takes the bilinear blend of the corrections of its coarse parents
+    Parallel::forRange(level.height, PARALLEL_GRAIN / level.width + 1, [&level, &coarse](size_t begin, size_t end) {
+        for (unsigned int y = (unsigned int) begin; y < end; y++) {
+            unsigned int y0 = y / 2, y1 = (y + 1) / 2;
+            for (unsigned int x = 0; x < level.width; x++) {
+                unsigned int x0 = x / 2, x1 = (x + 1) / 2;
+                size_t i = level.at(x, y);
+                size_t k00 = coarse.at(x0, y0), k01 = coarse.at(x1, y0);
+                size_t k10 = coarse.at(x0, y1), k11 = coarse.at(x1, y1);
+                float w = 0.25f * level.weight[i];
+                for (unsigned int c = 0; c < 3; c++) {
+                    const vector<float>& e = coarse.x[c];
+                    level.x[c][i] += w * (e[k00] + e[k01] + e[k10] + e[k11]);
+                }
+            }
+        }
+    });
+
+    smooth(level, MG_SWEEPS);
+}
+
+void Multigrid::solve(const vector<double> b[3], vector<double> x[3], unsigned int cycles) {
+    Level& fine = levels[0];
+    for (unsigned int c = 0; c < 3; c++) {
+        for (unsigned int i = 0; i < fine.width * fine.height; i++) {
+            size_t k = fine.at(i % fine.width, i / fine.width);
+            fine.b[c][k] = (float) b[c][i];
+            fine.x[c][k] = (float) x[c][i];
+        }
+    }
+    for (unsigned int n = 0; n < cycles; n++) {
+        cycle(0);
+    }
+    for (unsigned int c = 0; c < 3; c++) {
+        for (unsigned int i = 0; i < fine.width * fine.height; i++) {
+            x[c][i] = fine.x[c][fine.at(i % fine.width, i / fine.width)];
+        }
+    }
+}
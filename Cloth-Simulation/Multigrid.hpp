@@ -0,0 +1,76 @@
+//
+//  Multigrid.hpp
+//
+
+#ifndef Multigrid_hpp
+#define Multigrid_hpp
+
+#include <stdio.h>
+#include <vector>
+
+#include "ProjectiveSolver.hpp"
+
+#define MG_RADIUS       2       // reach of a stencil in grid points, enough for bend springs of span 2
+#define MG_STENCIL      25      // coefficients per grid point, (2 * MG_RADIUS + 1)^2
+#define MG_COARSEST     8       // a level with a side this short or shorter is not coarsened further
+#define MG_SWEEPS       2       // smoothing sweeps before and after the coarse correction
+#define MG_COARSE_SWEEPS 16     // smoothing sweeps that stand in for a solve on the coarsest level
+#define MG_OMEGA        0.6f    // damping of the Jacobi sweeps
+
+using namespace std;
+
+// Geometric multigrid for a symmetric positive definite system on a regular
+// grid, such as mass plus spring stiffness of a grid cloth. Each level halves
+// the grid in both directions. Corrections move from a coarse level to the
+// finer one by bilinear interpolation, residuals go back by its transpose, and
+// the coarse operators are the Galerkin products of the two, so every level
+// sees the same springs at a larger scale. Damped Jacobi smooths on every
+// level. Stiffness then crosses the whole grid in one V-cycle instead of one
+// spring per sweep, so the work to converge grows with the number of grid
+// points, not faster. Rows of pinned points hold their diagonal alone and
+// receive no coarse correction. A V-cycle from a zero guess is symmetric, so
+// it also serves as a preconditioner.
+class Multigrid {
+private:
+    struct Level {
+        unsigned int width, height;
+        unsigned int pitch;                 // grid points per stored row, including MG_RADIUS of padding per side
+        vector<float> stencil[MG_STENCIL];  // coefficient to the neighbour at each offset, zero in the padding
+        vector<float> invDiagonal;
+        vector<float> weight;               // 0 where a point takes no correction from the coarser level, else 1
+        vector<float> x[3], b[3], r[3];     // padded per component; the padding stays zero
+
+        size_t at(unsigned int column, unsigned int row) const {
+            return (size_t) (row + MG_RADIUS) * pitch + column + MG_RADIUS;
+        }
+    };
+
+    vector<Level> levels;
+
+    void allocate(Level& level, unsigned int width, unsigned int height);
+
+    // Galerkin product of the level above it
+    void coarsen(unsigned int l);
+
+    // r = b - A x
+    void residual(Level& level);
+
+    void smooth(Level& level, unsigned int sweeps);
+
+    void cycle(unsigned int l);
+
+public:
+    Multigrid(unsigned int width, unsigned int height);
+
+    // mass term of each grid point on the diagonal plus the stiffness of every spring; a spring to a pinned
+    // point only adds to the diagonal of its free end; false if a spring reaches further than MG_RADIUS
+    bool assemble(const vector<double>& diagonal, const vector<ProjectiveSpring>& springs,
+                  const vector<unsigned char>& pinned);
+
+    // V-cycles on A x = b with both indexed by grid point; x holds the first guess, zero to precondition
+    void solve(const vector<double> b[3], vector<double> x[3], unsigned int cycles);
+
+    size_t getLevelCount() { return levels.size(); }
+};
+
+#endif /* Multigrid_hpp */
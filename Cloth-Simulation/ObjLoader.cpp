@@ -0,0 +1,205 @@
+//
+//  ObjLoader.cpp
+//
+
+#include "ObjLoader.hpp"
+
+#include <string.h>
+#include <stdlib.h>
+#include <iostream>
+#include <unordered_map>
+
+// an undirected mesh edge and the vertex opposite to it in the first triangle seen
+struct ObjEdge {
+    uint32_t a, b;
+    uint32_t opposite;
+    uint32_t count;
+};
+
+static const char* skipBlanks(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t')) p++;
+    return p;
+}
+
+Cloth* ObjLoader::load(const char* path, float size, float totalMass, glm::vec3 color,
+                       float Ks, float Kd, float bendKs) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        cerr << "Failed to open mesh " << path << endl;
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    long fileSize = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    vector<char> text(fileSize > 0 ? fileSize + 1 : 1, '\0'); // terminated for strtof
+    bool read = fileSize <= 0 || fread(text.data(), 1, fileSize, file) == (size_t) fileSize;
+    fclose(file);
+    if (!read) {
+        cerr << "Failed to read mesh " << path << endl;
+        return NULL;
+    }
+
+    // only vertex positions and faces matter, polygons are split into fans
+    vector<glm::vec3> vertices;
+    vector<uint32_t> faces;
+    vector<long> polygon;
+    const char* p = text.data();
+    const char* end = p + glm::max(0L, fileSize);
+    for (unsigned int line = 1; p < end; line++) {
+        const char* lineEnd = (const char*) memchr(p, '\n', end - p);
+        if (!lineEnd) lineEnd = end;
+        p = skipBlanks(p, lineEnd);
+
+        if (lineEnd - p > 1 && p[0] == 'v' && (p[1] == ' ' || p[1] == '\t')) {
+            float xyz[3];
+            const char* q = p + 1;
+            for (unsigned int k = 0; k < 3; k++) {
+                char* after;
+                xyz[k] = strtof(q, &after);
+                if (after == q || after > lineEnd) {
+                    cerr << "Mesh " << path << " has a malformed vertex on line " << line << endl;
+                    return NULL;
+                }
+                q = after;
+            }
+            vertices.push_back(glm::vec3(xyz[0], xyz[1], xyz[2]));
+        }
+        else if (lineEnd - p > 1 && p[0] == 'f' && (p[1] == ' ' || p[1] == '\t')) {
+            polygon.clear();
+            const char* q = skipBlanks(p + 1, lineEnd);
+            while (q < lineEnd && *q != '\r' && *q != '#') {
+                char* after;
+                long id = strtol(q, &after, 10);
+                // indices count from 1, negative ones from the last vertex
+                id = id > 0 ? id - 1 : (long) vertices.size() + id;
+                if (after == q || id < 0 || id >= (long) vertices.size()) {
+                    cerr << "Mesh " << path << " has a bad face index on line " << line << endl;
+                    return NULL;
+                }
+                polygon.push_back(id);
+
+                // skip texture and normal indices
+                q = after;
+                while (q < lineEnd && *q != ' ' && *q != '\t' && *q != '\r') q++;
+                q = skipBlanks(q, lineEnd);
+            }
+            for (size_t k = 1; k + 1 < polygon.size(); k++) {
+                if (polygon[0] == polygon[k] || polygon[k] == polygon[k + 1] || polygon[0] == polygon[k + 1]) continue;
+                faces.insert(faces.end(), {(uint32_t) polygon[0], (uint32_t) polygon[k], (uint32_t) polygon[k + 1]});
+            }
+        }
+        p = lineEnd + 1;
+    }
+    if (faces.empty()) {
+        cerr << "Mesh " << path << " has no triangles" << endl;
+        return NULL;
+    }
+
+    // drop vertices no triangle uses, they would have no mass
+    vector<uint32_t> remap(vertices.size(), UINT32_MAX);
+    vector<glm::vec3> used;
+    for (uint32_t& v : faces) {
+        if (remap[v] == UINT32_MAX) {
+            remap[v] = (uint32_t) used.size();
+            used.push_back(vertices[v]);
+        }
+        v = remap[v];
+    }
+    uint32_t n = (uint32_t) used.size();
+
+    if (size > 0.0f) {
+        glm::vec3 lo = used[0], hi = used[0];
+        for (const glm::vec3& v : used) {
+            lo = glm::min(lo, v);
+            hi = glm::max(hi, v);
+        }
+        glm::vec3 extent = hi - lo;
+        float scale = size / glm::max(glm::max(extent.x, extent.y), glm::max(extent.z, 1e-6f));
+        glm::vec3 center = 0.5f * (lo + hi);
+        for (glm::vec3& v : used) {
+            v = (v - center) * scale;
+        }
+    }
+
+    // lumped masses: each vertex carries a third of the area around it
+    vector<float> area(n, 0.0f);
+    double totalArea = 0.0;
+    for (size_t t = 0; t < faces.size(); t += 3) {
+        glm::vec3 a = used[faces[t]], b = used[faces[t + 1]], c = used[faces[t + 2]];
+        float third = glm::length(glm::cross(b - a, c - a)) / 6.0f;
+        area[faces[t]] += third;
+        area[faces[t + 1]] += third;
+        area[faces[t + 2]] += third;
+        totalArea += 3.0 * third;
+    }
+
+    Cloth* cloth = new Cloth();
+    cloth->width = n;
+    cloth->height = 1;
+    cloth->totalMass = totalMass;
+    cloth->color = color;
+    cloth->wind = glm::vec3(0.0f);
+    cloth->terrain = NULL;
+    cloth->model = glm::mat4(1.0f);
+    cloth->Ks = Ks;
+    cloth->Kd = Kd;
+    cloth->bendStride = 0;
+    cloth->bendKs = bendKs;
+
+    // one table entry per undirected edge; the second triangle on an edge adds the bending spring
+    vector<ObjEdge> edges;
+    vector<pair<uint32_t, uint32_t>> bends;
+    edges.reserve(faces.size() / 2 + 3);
+    unordered_map<uint64_t, uint32_t> edgeTable(faces.size());
+    for (size_t t = 0; t < faces.size(); t += 3) {
+        for (unsigned int k = 0; k < 3; k++) {
+            uint32_t a = faces[t + k], b = faces[t + (k + 1) % 3], opposite = faces[t + (k + 2) % 3];
+            if (a > b) swap(a, b);
+            uint64_t key = ((uint64_t) a << 32) | b;
+            auto found = edgeTable.emplace(key, (uint32_t) edges.size());
+            if (found.second) {
+                edges.push_back({a, b, opposite, 1});
+                continue;
+            }
+            ObjEdge& edge = edges[found.first->second];
+            if (edge.count == 1 && edge.opposite != opposite) {
+                bends.push_back(make_pair(edge.opposite, opposite));
+            }
+            edge.count++;
+        }
+    }
+
+    cloth->positions = used;
+    cloth->restPositions = used;
+    cloth->normals = vector<glm::vec3>(n);
+    cloth->originalId = vector<unsigned int>(n);
+    cloth->reserveTopology(n, edges.size() + (bendKs > 0.0f ? bends.size() : 0), faces.size() / 3);
+    for (uint32_t i = 0; i < n; i++) {
+        float mass = totalArea > 0.0 ? (float) (totalMass * area[i] / totalArea) : 0.0f;
+        if (mass <= 0.0f) mass = totalMass / n;
+        cloth->particles.push_back(cloth->arena.create<Particle>(used[i].x, used[i].y, used[i].z, mass));
+        cloth->originalId[i] = i;
+    }
+
+    double edgeLength = 0.0;
+    for (const ObjEdge& e : edges) {
+        float len = glm::length(used[e.b] - used[e.a]);
+        cloth->springDampers.push_back(cloth->arena.create<SpringDamper>(cloth->particles[e.a], cloth->particles[e.b], len, Ks, Kd, true));
+        edgeLength += len;
+    }
+    if (bendKs > 0.0f) {
+        for (const pair<uint32_t, uint32_t>& bend : bends) {
+            float len = glm::length(used[bend.second] - used[bend.first]);
+            cloth->springDampers.push_back(cloth->arena.create<SpringDamper>(cloth->particles[bend.first], cloth->particles[bend.second], len, bendKs, Kd, false));
+        }
+    }
+    cloth->offset = (float) (edgeLength / edges.size());
+
+    cloth->indices.assign(faces.begin(), faces.end());
+    for (size_t t = 0; t < faces.size(); t += 3) {
+        cloth->triangles.push_back(cloth->arena.create<Triangle>(cloth->particles[faces[t]], cloth->particles[faces[t + 1]], cloth->particles[faces[t + 2]]));
+    }
+
+    cloth->updateNormals();
+    return cloth;
+}
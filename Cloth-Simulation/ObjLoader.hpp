@@ -0,0 +1,26 @@
+//
+//  ObjLoader.hpp
+//
+
+#ifndef ObjLoader_hpp
+#define ObjLoader_hpp
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "Cloth.hpp"
+
+#define OBJ_BEND_CONST  4.0f    // stiffness of the springs across shared edges
+
+// Builds a cloth from the triangles of a Wavefront OBJ file. Every mesh edge
+// becomes a spring at its rest length, and every edge shared by two triangles
+// gets a bending spring between the two vertices opposite to it. Both come
+// from a single pass over the faces with a hashed edge table.
+class ObjLoader {
+public:
+    // size > 0 scales the mesh so its largest extent is size and centers it at the origin; NULL on failure
+    static Cloth* load(const char* path, float size, float totalMass, glm::vec3 color,
+                       float Ks = SPRING_CONST, float Kd = DAMPING_CONST, float bendKs = OBJ_BEND_CONST);
+};
+
+#endif /* ObjLoader_hpp */
@@ -23,6 +23,8 @@ public:
     virtual void draw(const glm::mat4& viewProjMtx, GLuint shader) = 0;
     virtual void update() = 0;
     virtual void translate(glm::vec3 offset) = 0;
+    // share of the way from the state before the last update to the one after it to draw, if both are kept
+    virtual void setBlend(float /*alpha*/) {}
     virtual ~Object() {}
 };
 
@@ -0,0 +1,134 @@
+//
+//  Offscreen.cpp
+//
+
+#include "Offscreen.hpp"
+#include "Tracer.hpp"
+
+#include <iostream>
+
+Offscreen::Offscreen(int width, int height, const char* prefix) {
+    this->width = width;
+    this->height = height;
+    this->prefix = prefix;
+    this->framesRead = 0;
+    this->framesWritten = 0;
+    this->row = vector<unsigned char>(3 * width);
+
+    // color and depth attachments
+    glGenFramebuffers(1, &FBO);
+    glGenRenderbuffers(1, &colorRBO);
+    glGenRenderbuffers(1, &depthRBO);
+
+    glBindRenderbuffer(GL_RENDERBUFFER, colorRBO);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthRBO);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorRBO);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthRBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // pixel buffers the readback is streamed into
+    glGenBuffers(OFFSCREEN_PBOS, PBOs);
+    for (unsigned int i = 0; i < OFFSCREEN_PBOS; i++) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, PBOs[i]);
+        glBufferData(GL_PIXEL_PACK_BUFFER, 4 * width * height, NULL, GL_STREAM_READ);
+        fences[i] = 0;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+bool Offscreen::isComplete() {
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return status == GL_FRAMEBUFFER_COMPLETE;
+}
+
+void Offscreen::begin() {
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    glViewport(0, 0, width, height);
+}
+
+void Offscreen::end() {
+    // the oldest slot is reused now, so its frame has to reach the disk first
+    if (framesRead - framesWritten == OFFSCREEN_PBOS) {
+        writeFrame(framesWritten);
+    }
+
+    unsigned int slot = framesRead % OFFSCREEN_PBOS;
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, PBOs[slot]);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    framesRead++;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // write whatever has already landed without waiting for the GPU
+    while (framesWritten < framesRead - 1) {
+        GLsync fence = fences[framesWritten % OFFSCREEN_PBOS];
+        if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) break;
+        writeFrame(framesWritten);
+    }
+}
+
+void Offscreen::finish() {
+    while (framesWritten < framesRead) {
+        writeFrame(framesWritten);
+    }
+}
+
+void Offscreen::writeFrame(unsigned int frame) {
+    TRACE_SCOPE("write image");
+    unsigned int slot = frame % OFFSCREEN_PBOS;
+    glClientWaitSync(fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+    glDeleteSync(fences[slot]);
+    fences[slot] = 0;
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, PBOs[slot]);
+    const unsigned char* pixels = (const unsigned char*) glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, 4 * width * height, GL_MAP_READ_BIT);
+
+    char name[16];
+    snprintf(name, sizeof(name), "%05u.ppm", frame);
+    string path = prefix + name;
+    FILE* file = pixels ? fopen(path.c_str(), "wb") : NULL;
+    if (file) {
+        fprintf(file, "P6\n%d %d\n255\n", width, height);
+        // OpenGL rows start at the bottom, PPM rows at the top
+        for (int y = height - 1; y >= 0; y--) {
+            const unsigned char* src = pixels + 4 * width * y;
+            for (int x = 0; x < width; x++) {
+                row[3 * x] = src[4 * x];
+                row[3 * x + 1] = src[4 * x + 1];
+                row[3 * x + 2] = src[4 * x + 2];
+            }
+            fwrite(row.data(), 1, row.size(), file);
+        }
+        fclose(file);
+    }
+    else {
+        cerr << "Failed to write frame " << path << endl;
+    }
+
+    if (pixels) {
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    framesWritten++;
+}
+
+Offscreen::~Offscreen() {
+    for (unsigned int i = 0; i < OFFSCREEN_PBOS; i++) {
+        if (fences[i]) glDeleteSync(fences[i]);
+    }
+    glDeleteBuffers(OFFSCREEN_PBOS, PBOs);
+    glDeleteRenderbuffers(1, &colorRBO);
+    glDeleteRenderbuffers(1, &depthRBO);
+    glDeleteFramebuffers(1, &FBO);
+}
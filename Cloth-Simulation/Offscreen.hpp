@@ -0,0 +1,55 @@
+//
+//  Offscreen.hpp
+//
+
+#ifndef Offscreen_hpp
+#define Offscreen_hpp
+
+#include <stdio.h>
+#include <string>
+
+#include "Core.h"
+
+#define OFFSCREEN_PBOS  3   // frames in flight between glReadPixels and writing the image
+
+using namespace std;
+
+// Renders into a framebuffer object and writes every frame as a binary PPM.
+// Readback goes through a ring of pixel buffer objects, so the copy of frame i
+// is only mapped while frame i + OFFSCREEN_PBOS - 1 is being rendered.
+class Offscreen {
+private:
+    GLuint FBO;
+    GLuint colorRBO, depthRBO;
+    GLuint PBOs[OFFSCREEN_PBOS];
+    GLsync fences[OFFSCREEN_PBOS];
+
+    int width;
+    int height;
+    string prefix;              // output files are <prefix>00000.ppm, <prefix>00001.ppm, ...
+    unsigned int framesRead;    // frames whose readback has been issued
+    unsigned int framesWritten; // frames written to disk
+    vector<unsigned char> row;
+
+    void writeFrame(unsigned int frame);
+
+public:
+    Offscreen(int width, int height, const char* prefix);
+
+    bool isComplete();
+
+    // redirect rendering into the offscreen framebuffer
+    void begin();
+
+    // start the asynchronous readback of the frame and write the oldest finished one
+    void end();
+
+    // write every frame still in flight
+    void finish();
+
+    unsigned int getFramesWritten() { return framesWritten; }
+
+    ~Offscreen();
+};
+
+#endif /* Offscreen_hpp */
@@ -0,0 +1,172 @@
+//
+//  Parallel.cpp
+//
+
+#include "Parallel.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Tracer.hpp"
+
+// Worker threads sleep until a job is posted, then pull chunks from a shared
+// counter together with the posting thread.
+class ThreadPool {
+private:
+    vector<thread> workers;
+    mutex jobLock;
+    condition_variable jobReady;
+    condition_variable jobDone;
+    const function<void(size_t, size_t, size_t)>* job;
+    size_t jobSize;
+    size_t jobChunks;
+    atomic<size_t> nextChunk;
+    unsigned int busy;
+    unsigned long long jobId;
+    bool stopping;
+
+    void runChunks() {
+        size_t chunk;
+        while ((chunk = nextChunk.fetch_add(1)) < jobChunks) {
+            (*job)(chunk, chunk * jobSize / jobChunks, (chunk + 1) * jobSize / jobChunks);
+        }
+    }
+
+    void workerLoop() {
+        Tracer::setThreadName("worker");
+
+        unsigned long long seen = 0;
+        unique_lock<mutex> guard(jobLock);
+        while (true) {
+            jobReady.wait(guard, [this, seen] { return stopping || jobId != seen; });
+            if (stopping) return;
+            seen = jobId;
+
+            guard.unlock();
+            {
+                TRACE_SCOPE("parallel chunks");
+                runChunks();
+            }
+            guard.lock();
+
+            if (--busy == 0) jobDone.notify_one();
+        }
+    }
+
+public:
+    unsigned int threadCount;
+    bool deterministic;
+
+    ThreadPool() : job(NULL), jobSize(0), jobChunks(0), nextChunk(0), busy(0), jobId(0), stopping(false) {
+        threadCount = thread::hardware_concurrency();
+        if (threadCount < 1) threadCount = 1;
+        deterministic = false;
+    }
+
+    void stop() {
+        {
+            lock_guard<mutex> guard(jobLock);
+            stopping = true;
+        }
+        jobReady.notify_all();
+        for (thread& worker : workers) {
+            worker.join();
+        }
+        workers.clear();
+        stopping = false;
+    }
+
+    void run(size_t n, size_t chunks, const function<void(size_t, size_t, size_t)>& fn) {
+        if (chunks <= 1 || threadCount <= 1) {
+            for (size_t chunk = 0; chunk < chunks; chunk++) {
+                fn(chunk, chunk * n / chunks, (chunk + 1) * n / chunks);
+            }
+            return;
+        }
+        if (workers.size() != threadCount - 1) {
+            stop();
+            for (unsigned int i = 0; i + 1 < threadCount; i++) {
+                workers.push_back(thread(&ThreadPool::workerLoop, this));
+            }
+        }
+
+        {
+            lock_guard<mutex> guard(jobLock);
+            job = &fn;
+            jobSize = n;
+            jobChunks = chunks;
+            nextChunk = 0;
+            busy = (unsigned int) workers.size();
+            jobId++;
+        }
+        jobReady.notify_all();
+
+        runChunks();
+
+        unique_lock<mutex> guard(jobLock);
+        jobDone.wait(guard, [this] { return busy == 0; });
+        job = NULL;
+    }
+
+    ~ThreadPool() {
+        stop();
+    }
+};
+
+static ThreadPool pool;
+
+void Parallel::setThreadCount(unsigned int count) {
+    pool.threadCount = count < 1 ? 1 : count;
+}
+
+unsigned int Parallel::getThreadCount() {
+    return pool.threadCount;
+}
+
+void Parallel::setDeterministic(bool deterministic) {
+    pool.deterministic = deterministic;
+}
+
+bool Parallel::isDeterministic() {
+    return pool.deterministic;
+}
+
+void Parallel::forRange(size_t n, size_t grain, const function<void(size_t, size_t)>& fn) {
+    if (n == 0) return;
+    pool.run(n, chunkCount(n, grain), [&fn](size_t /*chunk*/, size_t begin, size_t end) {
+        fn(begin, end);
+    });
+}
+
+size_t Parallel::chunkCount(size_t n, size_t grain) {
+    size_t chunks = (n + grain - 1) / grain;
+    if (chunks > 4 * pool.threadCount) chunks = 4 * pool.threadCount;
+    return chunks;
+}
+
+void Parallel::forChunks(size_t n, size_t grain, const function<void(size_t, size_t, size_t)>& fn) {
+    if (n == 0) return;
+    pool.run(n, chunkCount(n, grain), fn);
+}
+
+double Parallel::reduce(size_t n, size_t grain, const function<double(size_t, size_t)>& fn) {
+    if (n == 0) return 0.0;
+    size_t chunks = (n + grain - 1) / grain;
+    size_t limit = pool.deterministic ? PARALLEL_CHUNKS : pool.threadCount;
+    if (chunks > limit) chunks = limit;
+
+    vector<double> partials(chunks, 0.0);
+    pool.run(n, chunks, [&fn, &partials](size_t chunk, size_t begin, size_t end) {
+        partials[chunk] = fn(begin, end);
+    });
+
+    // combine in chunk order, never in completion order
+    double sum = 0.0;
+    for (double partial : partials) {
+        sum += partial;
+    }
+    return sum;
+}
@@ -0,0 +1,45 @@
+//
+//  Parallel.hpp
+//
+
+#ifndef Parallel_hpp
+#define Parallel_hpp
+
+#include <stdio.h>
+#include <functional>
+
+#define PARALLEL_GRAIN      4096    // default number of items below which a loop stays on one thread
+#define PARALLEL_CHUNKS     64      // chunks of a reduction in deterministic mode
+
+using namespace std;
+
+// Fork-join loops on a small persistent thread pool. Loops only ever write
+// disjoint ranges; reductions combine per-chunk partial results in chunk
+// order. In deterministic mode the chunking depends on the problem size
+// alone, so results are bit-identical for any thread count. The pool runs one
+// job at a time: loops may only be started from the main thread, never from a
+// worker or a scene loader.
+class Parallel {
+public:
+    static void setThreadCount(unsigned int count);
+
+    static unsigned int getThreadCount();
+
+    static void setDeterministic(bool deterministic);
+
+    static bool isDeterministic();
+
+    // call fn(begin, end) on disjoint ranges covering [0, n)
+    static void forRange(size_t n, size_t grain, const function<void(size_t, size_t)>& fn);
+
+    // number of ranges forRange and forChunks split n items into
+    static size_t chunkCount(size_t n, size_t grain);
+
+    // as forRange, with the index of each range, below chunkCount(n, grain), first; for scratch kept per range
+    static void forChunks(size_t n, size_t grain, const function<void(size_t, size_t, size_t)>& fn);
+
+    // sum of fn(begin, end) over ranges covering [0, n)
+    static double reduce(size_t n, size_t grain, const function<double(size_t, size_t)>& fn);
+};
+
+#endif /* Parallel_hpp */
@@ -0,0 +1,172 @@
+//
+//  Player.cpp
+//
+
+#include "Player.hpp"
+#include "Tracer.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <string.h>
+#include <iostream>
+
+Player::Player(const unsigned char* mapping, size_t mappingSize)
+    : header(*(const CacheHeader*) mapping),
+      codec(header.numParticles, header.maxError) {
+    this->mapping = mapping;
+    this->mappingSize = mappingSize;
+
+    CacheFooter footer;
+    memcpy(&footer, mapping + mappingSize - sizeof(footer), sizeof(footer));
+    this->index = (const CacheIndexEntry*) (mapping + footer.indexOffset);
+    this->numFrames = footer.numFrames;
+
+    ring = vector<vector<glm::vec3>>(PLAYER_PREFETCH, vector<glm::vec3>(header.numParticles));
+    scratch = vector<glm::vec3>(header.numParticles);
+    ringFirst = 0;
+    ringCount = 0;
+    cursor = 0;
+    generation = 0;
+    seekPending = false;
+    stopping = false;
+    failed = false;
+
+    prefetcher = thread(&Player::prefetchLoop, this);
+}
+
+Player* Player::open(const char* path) {
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        cerr << "Failed to open cache " << path << endl;
+        return NULL;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t) info.st_size < sizeof(CacheHeader) + sizeof(CacheFooter)) {
+        cerr << "Cache " << path << " is too small" << endl;
+        close(fd);
+        return NULL;
+    }
+    size_t size = info.st_size;
+    void* mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        cerr << "Failed to map cache " << path << endl;
+        return NULL;
+    }
+    const unsigned char* base = (const unsigned char*) mapping;
+
+    CacheHeader header;
+    CacheFooter footer;
+    memcpy(&header, base, sizeof(header));
+    memcpy(&footer, base + size - sizeof(footer), sizeof(footer));
+    bool valid = header.magic == CACHE_MAGIC
+        && header.version == CACHE_VERSION
+        && header.numParticles > 0
+        && footer.magic == CACHE_MAGIC
+        && footer.indexOffset >= sizeof(CacheHeader)
+        && footer.indexOffset + (uint64_t) footer.numFrames * sizeof(CacheIndexEntry) + sizeof(footer) == size;
+    const CacheIndexEntry* index = (const CacheIndexEntry*) (base + footer.indexOffset);
+    for (unsigned int i = 0; valid && i < footer.numFrames; i++) {
+        valid = index[i].offset + index[i].size <= footer.indexOffset;
+    }
+    valid = valid && (footer.numFrames == 0 || index[0].keyframe);
+    if (!valid) {
+        cerr << "Cache " << path << " is corrupt, unfinished or from another version" << endl;
+        munmap(mapping, size);
+        return NULL;
+    }
+
+    // frames are mostly read front to back
+    madvise(mapping, size, MADV_SEQUENTIAL);
+    return new Player(base, size);
+}
+
+void Player::prefetchLoop() {
+    Tracer::setThreadName("prefetch");
+    
+    unique_lock<mutex> guard(ringLock);
+    while (!stopping) {
+        if (seekPending) {
+            // restart decoding at the closest keyframe before the target
+            seekPending = false;
+            cursor = ringFirst;
+            while (cursor > 0 && !index[cursor].keyframe) cursor--;
+            codec.reset();
+        }
+        if (failed || cursor >= numFrames || cursor >= ringFirst + PLAYER_PREFETCH) {
+            ringChanged.wait(guard);
+            continue;
+        }
+
+        unsigned int frame = cursor;
+        unsigned int decodeGeneration = generation;
+        glm::vec3* out = frame < ringFirst ? scratch.data() : ring[frame % PLAYER_PREFETCH].data();
+
+        // decode without holding the lock, the slot is outside the readable range
+        guard.unlock();
+        bool decoded;
+        {
+            TRACE_SCOPE("decode frame");
+            decoded = codec.decode(mapping + index[frame].offset, index[frame].size, out);
+        }
+        guard.lock();
+
+        if (decodeGeneration != generation) continue; // a seek made this frame stale
+        if (!decoded) {
+            cerr << "Failed to decode cache frame " << frame << endl;
+            failed = true;
+        }
+        else {
+            cursor++;
+            if (frame >= ringFirst) {
+                ringCount = frame + 1 - ringFirst;
+            }
+        }
+        ringChanged.notify_all();
+    }
+}
+
+bool Player::getFrame(unsigned int f, glm::vec3* positions) {
+    TRACE_SCOPE("get frame");
+    unique_lock<mutex> guard(ringLock);
+    if (f >= numFrames || failed) return false;
+
+    if (!seekPending && f >= ringFirst && f <= ringFirst + ringCount) {
+        // in the ring or decoded next: drop the frames before it
+        ringCount -= f - ringFirst;
+        ringFirst = f;
+    }
+    else if (!seekPending && f > ringFirst + ringCount && f < ringFirst + ringCount + PLAYER_PREFETCH) {
+        // a little ahead: keep decoding sequentially
+        ringFirst += ringCount;
+        ringCount = 0;
+    }
+    else {
+        ringFirst = f;
+        ringCount = 0;
+        seekPending = true;
+        generation++;
+    }
+    ringChanged.notify_all();
+
+    ringChanged.wait(guard, [this, f] { return failed || f < ringFirst + ringCount; });
+    if (failed) return false;
+
+    ringCount -= f - ringFirst;
+    ringFirst = f;
+    memcpy(positions, ring[f % PLAYER_PREFETCH].data(), sizeof(glm::vec3) * header.numParticles);
+    ringChanged.notify_all();
+    return true;
+}
+
+Player::~Player() {
+    {
+        lock_guard<mutex> guard(ringLock);
+        stopping = true;
+    }
+    ringChanged.notify_all();
+    prefetcher.join();
+    munmap((void*) mapping, mappingSize);
+}
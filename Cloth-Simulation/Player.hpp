@@ -0,0 +1,64 @@
+//
+//  Player.hpp
+//
+
+#ifndef Player_hpp
+#define Player_hpp
+
+#include <stdio.h>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+#include "FrameCodec.hpp"
+
+#define PLAYER_PREFETCH     16  // decoded frames kept ahead of the playhead
+
+class Player {
+private:
+    // read-only mapping of the whole cache
+    const unsigned char* mapping;
+    size_t mappingSize;
+    CacheHeader header;
+    const CacheIndexEntry* index;
+    unsigned int numFrames;
+
+    FrameCodec codec;               // only used by the prefetch thread
+
+    // ring of decoded frames [ringFirst, ringFirst + ringCount), frame f lives in slot f % PLAYER_PREFETCH
+    vector<vector<glm::vec3>> ring;
+    vector<glm::vec3> scratch;      // frames decoded on the way from a keyframe to a seek target
+    unsigned int ringFirst;
+    unsigned int ringCount;
+    unsigned int cursor;            // next frame the prefetch thread decodes
+    unsigned int generation;        // bumped by every seek so stale decodes are dropped
+    bool seekPending;
+    bool stopping;
+    bool failed;
+    mutex ringLock;
+    condition_variable ringChanged;
+    thread prefetcher;
+
+    Player(const unsigned char* mapping, size_t mappingSize);
+
+    void prefetchLoop();
+
+public:
+    // map a cache written by Recorder, NULL on failure
+    static Player* open(const char* path);
+
+    unsigned int getFrameCount() { return numFrames; }
+
+    unsigned int getParticleCount() { return header.numParticles; }
+
+    unsigned int getScene() { return header.scene; }
+
+    float getFrameTime() { return header.frameTime; }
+
+    // copy frame f into positions, waiting for the prefetch thread if needed; false on a corrupt cache
+    bool getFrame(unsigned int f, glm::vec3* positions);
+
+    ~Player();
+};
+
+#endif /* Player_hpp */
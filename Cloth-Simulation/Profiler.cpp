@@ -0,0 +1,79 @@
+//
+//  Profiler.cpp
+//
+
+#include "Profiler.hpp"
+
+#include <string.h>
+#include <algorithm>
+
+uint64_t Profiler::frameTotals[NUM_PHASES];
+uint32_t Profiler::history[NUM_PHASES][PROFILER_WINDOW];
+unsigned int Profiler::frames = 0;
+FILE* Profiler::csv = NULL;
+
+static const char* phaseNames[NUM_PHASES] = {
+    "springs", "aero", "integrate", "strain", "collision", "tiles", "normals", "remesh", "upload", "idle", "display", "frame"
+};
+
+bool Profiler::isEnabled() {
+#ifdef ENABLE_PROFILER
+    return true;
+#else
+    return false;
+#endif
+}
+
+const char* Profiler::getName(ProfilePhase phase) {
+    return phaseNames[phase];
+}
+
+void Profiler::endFrame() {
+    if (!isEnabled()) return;
+
+    unsigned int slot = frames % PROFILER_WINDOW;
+    for (unsigned int i = 0; i < NUM_PHASES; i++) {
+        history[i][slot] = (uint32_t) (frameTotals[i] / 1000);
+    }
+
+    if (csv) {
+        fprintf(csv, "%u", frames);
+        for (unsigned int i = 0; i < NUM_PHASES; i++) {
+            fprintf(csv, ",%.3f", frameTotals[i] / 1.0e6);
+        }
+        fputc('\n', csv);
+    }
+
+    memset(frameTotals, 0, sizeof(frameTotals));
+    frames++;
+}
+
+float Profiler::getPercentile(ProfilePhase phase, float p) {
+    unsigned int count = std::min(frames, (unsigned int) PROFILER_WINDOW);
+    if (count == 0) return 0.0f;
+
+    uint32_t sorted[PROFILER_WINDOW];
+    memcpy(sorted, history[phase], count * sizeof(uint32_t));
+    unsigned int k = std::min((unsigned int) (p * count), count - 1);
+    std::nth_element(sorted, sorted + k, sorted + count);
+    return sorted[k] / 1000.0f;
+}
+
+bool Profiler::openCSV(const char* path) {
+    closeCSV();
+    csv = fopen(path, "w");
+    if (!csv) return false;
+
+    fprintf(csv, "frame");
+    for (unsigned int i = 0; i < NUM_PHASES; i++) {
+        fprintf(csv, ",%s_ms", phaseNames[i]);
+    }
+    fputc('\n', csv);
+    return true;
+}
+
+void Profiler::closeCSV() {
+    if (!csv) return;
+    fclose(csv);
+    csv = NULL;
+}
@@ -0,0 +1,94 @@
+//
+//  Profiler.hpp
+//
+
+#ifndef Profiler_hpp
+#define Profiler_hpp
+
+#include <stdio.h>
+#include <stdint.h>
+#include <chrono>
+
+#include "Tracer.hpp"
+
+#define PROFILER_WINDOW     240 // frames kept for the rolling percentiles
+
+// Scoped phase timers compile to nothing unless ENABLE_PROFILER is defined;
+// with ENABLE_TRACING they also appear as events in the trace timeline.
+#if defined(ENABLE_PROFILER) || defined(ENABLE_TRACING)
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(phase) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(phase)
+#else
+#define PROFILE_SCOPE(phase)
+#endif
+
+enum ProfilePhase {
+    PHASE_SPRINGS,
+    PHASE_AERO,
+    PHASE_INTEGRATE,
+    PHASE_STRAIN,
+    PHASE_COLLISION,
+    PHASE_TILES,
+    PHASE_NORMALS,
+    PHASE_REMESH,
+    PHASE_UPLOAD,
+    PHASE_IDLE,
+    PHASE_DISPLAY,
+    PHASE_FRAME,
+    NUM_PHASES
+};
+
+// Phase totals are plain per-frame counters: only the main thread may time
+// phases, so code that other threads run, such as scene builds, must not step
+// a cloth.
+class Profiler {
+private:
+    static uint64_t frameTotals[NUM_PHASES];                // nanoseconds spent in the current frame
+    static uint32_t history[NUM_PHASES][PROFILER_WINDOW];   // per-frame totals in microseconds
+    static unsigned int frames;
+    static FILE* csv;
+
+public:
+    static bool isEnabled();
+
+    static const char* getName(ProfilePhase phase);
+
+    static void add(ProfilePhase phase, uint64_t nanoseconds) { frameTotals[phase] += nanoseconds; }
+
+    // close the current frame: fold its totals into the rolling window and the CSV
+    static void endFrame();
+
+    // p-th percentile (0..1) of the per-frame time of a phase over the window, in milliseconds
+    static float getPercentile(ProfilePhase phase, float p);
+
+    static unsigned int getFrameCount() { return frames; }
+
+    // stream one row per frame to a CSV file
+    static bool openCSV(const char* path);
+
+    static void closeCSV();
+};
+
+class ProfileScope {
+private:
+    ProfilePhase phase;
+    std::chrono::steady_clock::time_point start;
+
+public:
+    ProfileScope(ProfilePhase phase) : phase(phase), start(std::chrono::steady_clock::now()) {
+#ifdef ENABLE_TRACING
+        Tracer::record(Profiler::getName(phase), 'B');
+#endif
+    }
+
+    ~ProfileScope() {
+#ifdef ENABLE_TRACING
+        Tracer::record(Profiler::getName(phase), 'E');
+#endif
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        Profiler::add(phase, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    }
+};
+
+#endif /* Profiler_hpp */
@@ -0,0 +1,303 @@
+//
+//  ProjectiveSolver.cpp
+//
+
+#include "ProjectiveSolver.hpp"
+#include "Reorder.hpp"
+#include "Parallel.hpp"
+#include "Multigrid.hpp"
+
+#include <math.h>
+#include <stdint.h>
+
+ProjectiveSolver::ProjectiveSolver(const vector<ProjectiveSpring>& springs, float h, unsigned int gridWidth) {
+    this->h = h;
+    this->gridWidth = gridWidth;
+    this->springs = springs;
+    this->multigrid = NULL;
+    projections.resize(springs.size());
+}
+
+ProjectiveSolver::~ProjectiveSolver() {
+    delete multigrid;
+}
+
+size_t ProjectiveSolver::getLevelCount() {
+    return multigrid ? multigrid->getLevelCount() : 0;
+}
+
+bool ProjectiveSolver::fits(const vector<Particle*>& particles) {
+    if (pinned.size() != particles.size() || (factor.empty() && !multigrid)) return false;
+    for (size_t i = 0; i < particles.size(); i++) {
+        if (pinned[i] != (unsigned char) particles[i]->fixed) return false;
+    }
+    return true;
+}
+
+bool ProjectiveSolver::factorize(const vector<Particle*>& particles) {
+    unsigned int count = (unsigned int) particles.size();
+    pinned.resize(count);
+    for (unsigned int i = 0; i < count; i++) {
+        pinned[i] = particles[i]->fixed;
+    }
+
+    // rows for the free particles in reverse Cuthill-McKee order, which keeps the factor in a narrow band
+    vector<unsigned int> freeParticles;
+    vector<unsigned int> freeId(count, UINT32_MAX);
+    for (unsigned int i = 0; i < count; i++) {
+        if (pinned[i]) continue;
+        freeId[i] = (unsigned int) freeParticles.size();
+        freeParticles.push_back(i);
+    }
+    vector<pair<unsigned int, unsigned int>> edges;
+    for (const ProjectiveSpring& s : springs) {
+        if (!pinned[s.a] && !pinned[s.b]) edges.push_back(make_pair(freeId[s.a], freeId[s.b]));
+    }
+    unsigned int n = (unsigned int) freeParticles.size();
+    bool grid = gridWidth > 0 && count >= PD_MULTIGRID && count % gridWidth == 0;
+    vector<unsigned int> rcm = grid ? vector<unsigned int>() : Reorder::reverseCuthillMcKee(n, edges);
+    order.resize(n);
+    row.assign(count, UINT32_MAX);
+    for (unsigned int r = 0; r < n; r++) {
+        order[r] = grid ? freeParticles[r] : freeParticles[rcm[r]];
+        row[order[r]] = r;
+    }
+
+    // springs around each row, for gathering the right hand side without races
+    incidentStart.assign(n + 1, 0);
+    for (const ProjectiveSpring& s : springs) {
+        if (!pinned[s.a]) incidentStart[row[s.a] + 1]++;
+        if (!pinned[s.b]) incidentStart[row[s.b] + 1]++;
+    }
+    for (unsigned int r = 0; r < n; r++) {
+        incidentStart[r + 1] += incidentStart[r];
+    }
+    incidents.resize(incidentStart[n]);
+    vector<unsigned int> fill(incidentStart.begin(), incidentStart.end() - 1);
+    for (unsigned int i = 0; i < springs.size(); i++) {
+        const ProjectiveSpring& s = springs[i];
+        if (!pinned[s.a]) incidents[fill[row[s.a]]++] = {i, 1.0f, pinned[s.b] ? s.b : UINT32_MAX};
+        if (!pinned[s.b]) incidents[fill[row[s.b]]++] = {i, -1.0f, pinned[s.a] ? s.a : UINT32_MAX};
+    }
+
+    for (unsigned int c = 0; c < 3; c++) {
+        predicted[c].resize(n);
+        x[c].resize(n);
+        rhs[c].resize(n);
+    }
+    double invH2 = 1.0 / ((double) h * h);
+
+    // grid cloths keep particle order; the hierarchy takes the springs as they are
+    delete multigrid;
+    multigrid = NULL;
+    factor.clear();
+    if (grid) {
+        vector<double> diagonal(count);
+        for (unsigned int i = 0; i < count; i++) {
+            diagonal[i] = particles[i]->m * invH2;
+        }
+        multigrid = new Multigrid(gridWidth, count / gridWidth);
+        if (multigrid->assemble(diagonal, springs, pinned)) {
+            for (unsigned int c = 0; c < 3; c++) {
+                gridB[c].assign(count, 0.0);
+                gridX[c].assign(count, 0.0);
+            }
+            return true;
+        }
+        // springs too long for the stencil, factor them in particle order after all
+        delete multigrid;
+        multigrid = NULL;
+    }
+
+    // the skyline of each row reaches back to its furthest neighbour
+    first.resize(n);
+    for (unsigned int r = 0; r < n; r++) {
+        first[r] = r;
+    }
+    for (const pair<unsigned int, unsigned int>& e : edges) {
+        unsigned int a = row[freeParticles[e.first]];
+        unsigned int b = row[freeParticles[e.second]];
+        if (a < b) swap(a, b);
+        first[a] = glm::min(first[a], b);
+    }
+    rowStart.resize(n + 1);
+    rowStart[0] = 0;
+    for (unsigned int r = 0; r < n; r++) {
+        rowStart[r + 1] = rowStart[r] + (r - first[r] + 1);
+    }
+
+    // assemble M / h^2 plus k on the diagonal and -k off it for every spring
+    factor.assign(rowStart[n], 0.0);
+    auto at = [this](unsigned int r, unsigned int c) -> double& { return factor[rowStart[r] + c - first[r]]; };
+    for (unsigned int r = 0; r < n; r++) {
+        at(r, r) = particles[order[r]]->m * invH2;
+    }
+    for (const ProjectiveSpring& s : springs) {
+        if (!pinned[s.a]) at(row[s.a], row[s.a]) += s.k;
+        if (!pinned[s.b]) at(row[s.b], row[s.b]) += s.k;
+        if (!pinned[s.a] && !pinned[s.b]) {
+            unsigned int ra = row[s.a], rb = row[s.b];
+            at(glm::max(ra, rb), glm::min(ra, rb)) -= s.k;
+        }
+    }
+
+    // Cholesky in place, row by row; fill stays inside the skyline
+    for (unsigned int i = 0; i < n; i++) {
+        for (unsigned int j = first[i]; j <= i; j++) {
+            unsigned int k0 = glm::max(first[i], first[j]);
+            const double* li = &factor[rowStart[i] + k0 - first[i]];
+            const double* lj = &factor[rowStart[j] + k0 - first[j]];
+            double sum = at(i, j);
+            for (unsigned int k = 0; k < j - k0; k++) {
+                sum -= li[k] * lj[k];
+            }
+            if (j < i) {
+                at(i, j) = sum / at(j, j);
+            }
+            else if (sum > 0.0) {
+                at(i, i) = sqrt(sum);
+            }
+            else {
+                factor.clear();
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void ProjectiveSolver::solve(const vector<Particle*>& particles) {
+    unsigned int n = (unsigned int) order.size();
+    if (multigrid) {
+        // pinned particles sit at their positions, which their diagonal alone reproduces
+        double invH2 = 1.0 / ((double) h * h);
+        for (unsigned int i = 0; i < particles.size(); i++) {
+            if (!pinned[i]) continue;
+            double m = particles[i]->m * invH2;
+            for (unsigned int c = 0; c < 3; c++) {
+                gridX[c][i] = particles[i]->p[c];
+                gridB[c][i] = m * particles[i]->p[c];
+            }
+        }
+        for (unsigned int c = 0; c < 3; c++) {
+            for (unsigned int r = 0; r < n; r++) {
+                gridB[c][order[r]] = rhs[c][r];
+                gridX[c][order[r]] = x[c][r];
+            }
+        }
+        multigrid->solve(gridB, gridX, PD_CYCLES);
+        for (unsigned int c = 0; c < 3; c++) {
+            for (unsigned int r = 0; r < n; r++) {
+                x[c][r] = gridX[c][order[r]];
+            }
+        }
+        return;
+    }
+
+    for (unsigned int c = 0; c < 3; c++) {
+        x[c] = rhs[c];
+    }
+    double* __restrict x0 = x[0].data();
+    double* __restrict x1 = x[1].data();
+    double* __restrict x2 = x[2].data();
+
+    // L y = b, a dot product over the stored part of each row
+    for (unsigned int i = 0; i < n; i++) {
+        const double* li = &factor[rowStart[i]];
+        unsigned int f = first[i];
+        double s0 = x0[i], s1 = x1[i], s2 = x2[i];
+        for (unsigned int j = f; j < i; j++) {
+            double l = li[j - f];
+            s0 -= l * x0[j];
+            s1 -= l * x1[j];
+            s2 -= l * x2[j];
+        }
+        double d = li[i - f];
+        x0[i] = s0 / d;
+        x1[i] = s1 / d;
+        x2[i] = s2 / d;
+    }
+
+    // L^T x = y, each solved row pushed back along its stored part
+    for (unsigned int i = n; i-- > 0;) {
+        const double* li = &factor[rowStart[i]];
+        unsigned int f = first[i];
+        double d = li[i - f];
+        double v0 = x0[i] / d, v1 = x1[i] / d, v2 = x2[i] / d;
+        x0[i] = v0;
+        x1[i] = v1;
+        x2[i] = v2;
+        for (unsigned int j = f; j < i; j++) {
+            double l = li[j - f];
+            x0[j] -= l * v0;
+            x1[j] -= l * v1;
+            x2[j] -= l * v2;
+        }
+    }
+}
+
+bool ProjectiveSolver::step(const vector<Particle*>& particles, glm::vec3 gravity) {
+    if (!fits(particles) && !factorize(particles)) return false;
+
+    // inertia and external forces alone, also the first guess
+    unsigned int n = (unsigned int) order.size();
+    for (unsigned int r = 0; r < n; r++) {
+        const Particle* particle = particles[order[r]];
+        glm::vec3 s = particle->p + h * particle->v + (h * h) * (particle->f / particle->m + gravity);
+        for (unsigned int c = 0; c < 3; c++) {
+            predicted[c][r] = s[c];
+            x[c][r] = s[c];
+        }
+    }
+
+    double invH2 = 1.0 / ((double) h * h);
+    for (unsigned int iteration = 0; iteration < PD_ITERATIONS; iteration++) {
+        // local: every spring at its rest length along its current direction
+        Parallel::forRange(springs.size(), PARALLEL_GRAIN, [this, &particles](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                const ProjectiveSpring& s = springs[i];
+                unsigned int ra = row[s.a], rb = row[s.b];
+                glm::vec3 pa = ra == UINT32_MAX ? particles[s.a]->p : glm::vec3(x[0][ra], x[1][ra], x[2][ra]);
+                glm::vec3 pb = rb == UINT32_MAX ? particles[s.b]->p : glm::vec3(x[0][rb], x[1][rb], x[2][rb]);
+                glm::vec3 e = pa - pb;
+                float len = glm::length(e);
+                projections[i] = len > 0.0f ? (s.l / len) * e : e;
+            }
+        });
+
+        // global: right hand side per row, then the prefactored solve
+        Parallel::forRange(n, PARALLEL_GRAIN, [this, &particles, invH2](size_t begin, size_t end) {
+            for (size_t r = begin; r < end; r++) {
+                double m = particles[order[r]]->m * invH2;
+                double b[3] = {m * predicted[0][r], m * predicted[1][r], m * predicted[2][r]};
+                for (unsigned int k = incidentStart[r]; k < incidentStart[r + 1]; k++) {
+                    const Incident& incident = incidents[k];
+                    float stiffness = springs[incident.spring].k;
+                    glm::vec3 pull = (incident.sign * stiffness) * projections[incident.spring];
+                    if (incident.pinnedEnd != UINT32_MAX) {
+                        pull += stiffness * particles[incident.pinnedEnd]->p;
+                    }
+                    b[0] += pull.x;
+                    b[1] += pull.y;
+                    b[2] += pull.z;
+                }
+                rhs[0][r] = b[0];
+                rhs[1][r] = b[1];
+                rhs[2][r] = b[2];
+            }
+        });
+        solve(particles);
+    }
+
+    // velocities from the distance covered
+    for (unsigned int r = 0; r < n; r++) {
+        Particle* particle = particles[order[r]];
+        glm::vec3 p((float) x[0][r], (float) x[1][r], (float) x[2][r]);
+        particle->v = (p - particle->p) / h;
+        particle->p = p;
+    }
+    for (Particle* particle : particles) {
+        particle->f = glm::vec3(0.0f);
+    }
+    return true;
+}
@@ -0,0 +1,96 @@
+//
+//  ProjectiveSolver.hpp
+//
+
+#ifndef ProjectiveSolver_hpp
+#define ProjectiveSolver_hpp
+
+#include <stdio.h>
+#include <vector>
+
+#include "Particle.hpp"
+
+#define PD_ITERATIONS   5       // local and global steps per time step
+#define PD_MULTIGRID    16384   // particles of a grid cloth from which the global step runs multigrid instead of the factor
+#define PD_CYCLES       1       // V-cycles per global step with multigrid, warm started from the last iterate
+
+using namespace std;
+
+class Multigrid;
+
+// a spring as the solver sees it: particle indices, rest length and stiffness
+struct ProjectiveSpring {
+    unsigned int a, b;
+    float l;
+    float k;
+};
+
+// Projective Dynamics (Bouaziz et al. 2014) for a mass-spring cloth. Each
+// iteration projects every spring onto its rest length on its own, then solves
+// one linear system for all particles at once. The system matrix M / h^2 + sum
+// of k over the springs' stencils depends only on the masses, the springs, the
+// pinned particles and the step, so it is factored once with a skyline
+// Cholesky in reverse Cuthill-McKee order, and every iteration costs two
+// triangular solves. Pinned particles are taken out of the system; the factor
+// is only rebuilt when the set of pinned particles changes. The factor of a
+// large grid cloth would hold a full row of the grid for every particle, so
+// from PD_MULTIGRID particles on, grid cloths solve by multigrid cycles instead.
+class ProjectiveSolver {
+private:
+    // a spring seen from one of its free ends
+    struct Incident {
+        unsigned int spring;
+        float sign;             // +1 at the first end, -1 at the second
+        unsigned int pinnedEnd; // particle at the other end if it is pinned, UINT32_MAX otherwise
+    };
+
+    float h;                            // step the matrix is built for
+    unsigned int gridWidth;             // particles per row of a grid cloth, 0 for other cloths
+    vector<ProjectiveSpring> springs;
+    vector<unsigned char> pinned;       // pinned particles when the factor was built
+    vector<unsigned int> order;         // particle of each system row
+    vector<unsigned int> row;           // system row of each particle, UINT32_MAX when pinned
+    vector<unsigned int> incidentStart; // springs at row r are [incidentStart[r], incidentStart[r + 1]) of incidents
+    vector<Incident> incidents;
+
+    // lower triangle of the Cholesky factor, row r holds columns [first[r], r]
+    vector<unsigned int> first;
+    vector<size_t> rowStart;
+    vector<double> factor;
+
+    // hierarchy for large grid cloths, NULL with the factor; its right hand side and iterate by particle
+    Multigrid* multigrid;
+    vector<double> gridB[3], gridX[3];
+
+    // per-step work arrays, one per component
+    vector<double> predicted[3];    // positions the particles would reach without springs
+    vector<double> x[3];            // current iterate, then the new positions
+    vector<double> rhs[3];          // right hand side of the global step
+    vector<glm::vec3> projections;  // each spring at its rest length
+
+    bool fits(const vector<Particle*>& particles);
+
+    bool factorize(const vector<Particle*>& particles);
+
+    // the global step, x from rhs for all three components
+    void solve(const vector<Particle*>& particles);
+
+public:
+    // particles of a grid cloth are numbered row by row with gridWidth per row
+    ProjectiveSolver(const vector<ProjectiveSpring>& springs, float h, unsigned int gridWidth = 0);
+
+    ~ProjectiveSolver();
+
+    // advance the particles by h under their springs, gravity and the external forces in f, which are cleared;
+    // false if the system is not positive definite
+    bool step(const vector<Particle*>& particles, glm::vec3 gravity);
+
+    // rows of the system, stored entries of the factor and levels of the multigrid hierarchy
+    size_t getRowCount() { return order.size(); }
+
+    size_t getFactorSize() { return factor.size(); }
+
+    size_t getLevelCount();
+};
+
+#endif /* ProjectiveSolver_hpp */
@@ -0,0 +1,138 @@
+//
+//  Recorder.cpp
+//
+
+#include "Recorder.hpp"
+#include "Tracer.hpp"
+
+#include <string.h>
+#include <iostream>
+
+Recorder::Recorder(FILE* file, unsigned int numParticles, float maxError)
+    : codec(numParticles, maxError) {
+    this->file = file;
+    this->numParticles = numParticles;
+    this->framesQueued = 0;
+    this->bytesWritten = sizeof(CacheHeader);
+    this->stopping = false;
+    this->failed = false;
+    this->stalls = 0;
+
+    slots = vector<vector<glm::vec3>>(RECORDER_QUEUE, vector<glm::vec3>(numParticles));
+    for (unsigned int i = 0; i < RECORDER_QUEUE; i++) {
+        freeSlots.push_back(i);
+    }
+    writer = thread(&Recorder::writeLoop, this);
+}
+
+Recorder* Recorder::open(const char* path, unsigned int numParticles, unsigned int scene,
+                         float frameTime, float maxError) {
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        cerr << "Failed to create cache " << path << endl;
+        return NULL;
+    }
+
+    CacheHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = CACHE_MAGIC;
+    header.version = CACHE_VERSION;
+    header.numParticles = numParticles;
+    header.scene = scene;
+    header.frameTime = frameTime;
+    header.maxError = maxError;
+    header.keyInterval = CACHE_KEY_INTERVAL;
+    if (fwrite(&header, sizeof(header), 1, file) != 1) {
+        cerr << "Failed to write cache " << path << endl;
+        fclose(file);
+        return NULL;
+    }
+
+    return new Recorder(file, numParticles, maxError);
+}
+
+void Recorder::record(const vector<glm::vec3>& positions) {
+    if (positions.size() != numParticles) return;
+
+    TRACE_SCOPE("record frame");
+    
+    unsigned int slot;
+    {
+        unique_lock<mutex> guard(queueLock);
+        if (freeSlots.empty()) {
+            stalls++;
+            slotFreed.wait(guard, [this] { return !freeSlots.empty(); });
+        }
+        slot = freeSlots.front();
+        freeSlots.pop_front();
+    }
+
+    // the copy happens outside the lock, the writer does not touch a slot it has not been handed
+    memcpy(slots[slot].data(), positions.data(), sizeof(glm::vec3) * numParticles);
+
+    {
+        lock_guard<mutex> guard(queueLock);
+        pendingSlots.push_back(slot);
+        framesQueued++;
+    }
+    frameQueued.notify_one();
+}
+
+void Recorder::writeLoop() {
+    Tracer::setThreadName("recorder");
+    
+    unsigned int frame = 0;
+    while (true) {
+        unsigned int slot;
+        {
+            unique_lock<mutex> guard(queueLock);
+            frameQueued.wait(guard, [this] { return stopping || !pendingSlots.empty(); });
+            if (pendingSlots.empty()) break; // stopping and drained
+            slot = pendingSlots.front();
+            pendingSlots.pop_front();
+        }
+
+        if (!failed) {
+            TRACE_SCOPE("encode frame");
+            bool keyframe = frame % CACHE_KEY_INTERVAL == 0;
+            block.clear();
+            CacheIndexEntry entry;
+            entry.offset = bytesWritten;
+            entry.keyframe = keyframe ? 1 : 0;
+            if (codec.encode(slots[slot].data(), keyframe, block)
+                && fwrite(block.data(), 1, block.size(), file) == block.size()) {
+                entry.size = (uint32_t) block.size();
+                index.push_back(entry);
+                bytesWritten += block.size();
+            }
+            else {
+                cerr << "Failed to write cache frame " << frame << ", recording stopped" << endl;
+                failed = true;
+            }
+        }
+        frame++;
+
+        {
+            lock_guard<mutex> guard(queueLock);
+            freeSlots.push_back(slot);
+        }
+        slotFreed.notify_one();
+    }
+}
+
+Recorder::~Recorder() {
+    {
+        lock_guard<mutex> guard(queueLock);
+        stopping = true;
+    }
+    frameQueued.notify_one();
+    writer.join();
+
+    CacheFooter footer;
+    footer.indexOffset = bytesWritten;
+    footer.numFrames = (uint32_t) index.size();
+    footer.magic = CACHE_MAGIC;
+    fwrite(index.data(), sizeof(CacheIndexEntry), index.size(), file);
+    fwrite(&footer, sizeof(footer), 1, file);
+    fclose(file);
+}
@@ -0,0 +1,64 @@
+//
+//  Recorder.hpp
+//
+
+#ifndef Recorder_hpp
+#define Recorder_hpp
+
+#include <stdio.h>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+#include "FrameCodec.hpp"
+
+#define RECORDER_QUEUE      8           // frames buffered between the simulation and the writer
+#define RECORDER_MAX_ERROR  0.0005f     // default quantisation error bound (meters)
+
+class Recorder {
+private:
+    FILE* file;
+    FrameCodec codec;
+    unsigned int numParticles;
+    unsigned int framesQueued;
+    atomic<uint64_t> bytesWritten;
+    vector<CacheIndexEntry> index;
+    vector<unsigned char> block;
+
+    // bounded queue of frame slots shared with the writer thread
+    vector<vector<glm::vec3>> slots;
+    deque<unsigned int> freeSlots;
+    deque<unsigned int> pendingSlots;
+    mutex queueLock;
+    condition_variable slotFreed;
+    condition_variable frameQueued;
+    bool stopping;
+    bool failed;
+    unsigned int stalls;        // number of record calls that had to wait for the writer
+    thread writer;
+
+    Recorder(FILE* file, unsigned int numParticles, float maxError);
+
+    void writeLoop();
+
+public:
+    // start a cache file for a cloth with numParticles particles, NULL on failure
+    static Recorder* open(const char* path, unsigned int numParticles, unsigned int scene,
+                          float frameTime, float maxError = RECORDER_MAX_ERROR);
+
+    // queue a copy of the positions; only waits if the writer is a full queue behind
+    void record(const vector<glm::vec3>& positions);
+
+    unsigned int getFrameCount() { return framesQueued; }
+
+    unsigned int getStalls() { return stalls; }
+
+    uint64_t getBytesWritten() { return bytesWritten; }
+
+    // drain the queue, then write the frame index and footer
+    ~Recorder();
+};
+
+#endif /* Recorder_hpp */
@@ -0,0 +1,591 @@
+//
+//  Remesher.cpp
+//
+
+#include "Remesher.hpp"
+#include "Cloth.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <math.h>
+#include <float.h>
+
+Remesher::Remesher(Cloth* cloth) : cloth(cloth), frame(0) {
+    vector<Particle*>& particles = cloth->particles;
+    vector<unsigned int>& indices = cloth->indices;
+    unsigned int n = (unsigned int) particles.size();
+
+    // rest positions by current index, so they come and go with the particles' slots
+    vector<glm::vec3> rest(n);
+    for (unsigned int i = 0; i < n; i++) {
+        rest[i] = cloth->restPositions[cloth->originalId[i]];
+        cloth->originalId[i] = i;
+    }
+    cloth->restPositions = rest;
+    cloth->currentId.clear();
+
+    vertexFaces.assign(n, vector<unsigned int>());
+    for (unsigned int f = 0; f < cloth->triangles.size(); f++) {
+        for (unsigned int k = 0; k < 3; k++) {
+            unsigned int a = indices[3 * f + k], b = indices[3 * f + (k + 1) % 3];
+            vertexFaces[a].push_back(f);
+            Edge& edge = edges.emplace(key(a, b), Edge{{UINT32_MAX, UINT32_MAX}, 0, NULL, NULL}).first->second;
+            if (edge.count < 2) edge.faces[edge.count] = f;
+            edge.count++;
+        }
+    }
+
+    // a spring along an edge is its spring, any other one bends across the edge between its ends
+    unordered_map<const Particle*, unsigned int> id(n);
+    for (unsigned int i = 0; i < n; i++) {
+        id[particles[i]] = i;
+    }
+    unordered_map<uint64_t, SpringDamper*> others;
+    for (SpringDamper* s : cloth->springDampers) {
+        uint64_t k = key(id[s->p1], id[s->p2]);
+        auto found = edges.find(k);
+        if (found != edges.end() && !found->second.spring) found->second.spring = s;
+        else others[k] = s;
+    }
+    for (auto& entry : edges) {
+        unsigned int a = (unsigned int) (entry.first >> 32), b = (unsigned int) entry.first;
+        Edge& edge = entry.second;
+        if (!edge.spring) {
+            edge.spring = addSpring(particles[a], particles[b], glm::length(rest[a] - rest[b]), cloth->Ks, true);
+        }
+        if (edge.count != 2) continue;
+        auto found = others.find(key(opposite(edge.faces[0], a, b), opposite(edge.faces[1], a, b)));
+        if (found == others.end()) continue;
+        edge.bend = found->second;
+        others.erase(found);
+    }
+
+    area.assign(n, 0.0f);
+    double totalArea = 0.0;
+    for (unsigned int f = 0; f < cloth->triangles.size(); f++) {
+        addArea(f, 1.0f);
+        totalArea += restArea(f);
+    }
+    density = totalArea > 0.0 ? (float) (cloth->totalMass / totalArea) : 0.0f;
+    refined.assign(n, 0);
+    minLength = cloth->offset / (1 << REMESH_LEVELS);
+}
+
+unsigned int Remesher::opposite(unsigned int face, unsigned int a, unsigned int b) {
+    const unsigned int* corners = &cloth->indices[3 * face];
+    for (unsigned int k = 0; k < 3; k++) {
+        if (corners[k] != a && corners[k] != b) return corners[k];
+    }
+    return corners[0];
+}
+
+float Remesher::bend(const Edge& edge) {
+    if (edge.count != 2) return 0.0f;
+    return 1.0f - glm::dot(cloth->triangles[edge.faces[0]]->n, cloth->triangles[edge.faces[1]]->n);
+}
+
+float Remesher::restArea(unsigned int face) {
+    const unsigned int* corners = &cloth->indices[3 * face];
+    const vector<glm::vec3>& rest = cloth->restPositions;
+    return 0.5f * glm::length(glm::cross(rest[corners[1]] - rest[corners[0]], rest[corners[2]] - rest[corners[0]]));
+}
+
+void Remesher::addArea(unsigned int face, float sign) {
+    float third = sign * restArea(face) / 3.0f;
+    for (unsigned int k = 0; k < 3; k++) {
+        area[cloth->indices[3 * face + k]] += third;
+    }
+}
+
+void Remesher::updateMass(unsigned int i) {
+    if (area[i] > 0.0f && density > 0.0f) cloth->particles[i]->m = density * area[i];
+}
+
+bool Remesher::stable(float mass, size_t edgeCount) {
+    if (cloth->projective) return true;
+    if (mass <= 0.0f) return false;
+
+    // as for the tile levels: neighbours swinging against each other, one spring and about one bend
+    // spring per edge; symplectic Euler with explicit damping is stable while dt^2 K / 4 + dt D / 2 < 1
+    float bendKs = glm::max(0.0f, cloth->bendKs);
+    float stiffness = edgeCount * (cloth->Ks + bendKs) / mass;
+    float damping = edgeCount * cloth->Kd * (bendKs > 0.0f ? 2.0f : 1.0f) / mass;
+    float dt = TIME_STEP;
+    return dt * dt * stiffness / 4.0f + dt * damping / 2.0f <= REMESH_SAFETY;
+}
+
+SpringDamper* Remesher::addSpring(Particle* p1, Particle* p2, float l, float Ks, bool stretch) {
+    SpringDamper* s;
+    if (freeSprings.empty()) {
+        s = cloth->arena.create<SpringDamper>(p1, p2, l, Ks, cloth->Kd, stretch);
+    }
+    else {
+        s = freeSprings.back();
+        freeSprings.pop_back();
+        *s = SpringDamper(p1, p2, l, Ks, cloth->Kd, stretch);
+    }
+    cloth->springDampers.push_back(s);
+    return s;
+}
+
+void Remesher::updateBend(unsigned int a, unsigned int b) {
+    auto found = edges.find(key(a, b));
+    if (found == edges.end()) return;
+    Edge& edge = found->second;
+    if (edge.count != 2 || cloth->bendKs <= 0.0f) {
+        if (edge.bend) droppedSprings.push_back(edge.bend);
+        edge.bend = NULL;
+        return;
+    }
+
+    unsigned int c = opposite(edge.faces[0], a, b), d = opposite(edge.faces[1], a, b);
+    float l = glm::length(cloth->restPositions[c] - cloth->restPositions[d]);
+    if (!edge.bend) {
+        edge.bend = addSpring(cloth->particles[c], cloth->particles[d], l, cloth->bendKs, false);
+        return;
+    }
+    edge.bend->p1 = cloth->particles[c];
+    edge.bend->p2 = cloth->particles[d];
+    edge.bend->l = l;
+}
+
+void Remesher::setCorners(unsigned int face, const unsigned int* corners) {
+    Triangle* t = cloth->triangles[face];
+    t->a = cloth->particles[corners[0]];
+    t->b = cloth->particles[corners[1]];
+    t->c = cloth->particles[corners[2]];
+    copy_n(corners, 3, &cloth->indices[3 * face]);
+}
+
+void Remesher::removeFace(unsigned int face) {
+    vector<unsigned int>& indices = cloth->indices;
+    vector<Triangle*>& triangles = cloth->triangles;
+    for (unsigned int k = 0; k < 3; k++) {
+        unsigned int a = indices[3 * face + k], b = indices[3 * face + (k + 1) % 3];
+        vector<unsigned int>& around = vertexFaces[a];
+        around.erase(remove(around.begin(), around.end(), face), around.end());
+
+        auto found = edges.find(key(a, b));
+        if (found == edges.end()) continue;
+        Edge& edge = found->second;
+        if (edge.faces[0] == face) {
+            edge.faces[0] = edge.faces[1];
+            edge.faces[1] = UINT32_MAX;
+            edge.count--;
+        }
+        else if (edge.faces[1] == face) {
+            edge.faces[1] = UINT32_MAX;
+            edge.count--;
+        }
+    }
+
+    freeTriangles.push_back(triangles[face]);
+    unsigned int last = (unsigned int) triangles.size() - 1;
+    if (face != last) {
+        for (unsigned int k = 0; k < 3; k++) {
+            unsigned int a = indices[3 * last + k], b = indices[3 * last + (k + 1) % 3];
+            replace(vertexFaces[a].begin(), vertexFaces[a].end(), last, face);
+            auto found = edges.find(key(a, b));
+            if (found == edges.end()) continue;
+            for (unsigned int s = 0; s < 2; s++) {
+                if (found->second.faces[s] == last) found->second.faces[s] = face;
+            }
+        }
+        triangles[face] = triangles[last];
+        copy_n(&indices[3 * last], 3, &indices[3 * face]);
+    }
+    triangles.pop_back();
+    indices.resize(3 * last);
+}
+
+void Remesher::removeParticle(unsigned int i) {
+    vector<Particle*>& particles = cloth->particles;
+    unsigned int last = (unsigned int) particles.size() - 1;
+    freeParticles.push_back(particles[i]);
+    if (i != last) {
+        vector<unsigned int> around;
+        neighbours(last, around);
+        for (unsigned int x : around) {
+            auto found = edges.find(key(last, x));
+            if (found == edges.end()) continue;
+            Edge edge = found->second;
+            edges.erase(found);
+            edges[key(i, x)] = edge;
+        }
+        for (unsigned int f : vertexFaces[last]) {
+            replace(&cloth->indices[3 * f], &cloth->indices[3 * f + 3], last, i);
+        }
+        for (unsigned int& id : cloth->fixedId) {
+            if (id == last) id = i;
+        }
+        particles[i] = particles[last];
+        cloth->positions[i] = cloth->positions[last];
+        cloth->normals[i] = cloth->normals[last];
+        cloth->restPositions[i] = cloth->restPositions[last];
+        area[i] = area[last];
+        refined[i] = refined[last];
+        vertexFaces[i].swap(vertexFaces[last]);
+    }
+    particles.pop_back();
+    cloth->positions.pop_back();
+    cloth->normals.pop_back();
+    cloth->restPositions.pop_back();
+    cloth->originalId.pop_back();
+    area.pop_back();
+    refined.pop_back();
+    vertexFaces.pop_back();
+}
+
+void Remesher::neighbours(unsigned int i, vector<unsigned int>& out) {
+    out.clear();
+    for (unsigned int f : vertexFaces[i]) {
+        for (unsigned int k = 0; k < 3; k++) {
+            unsigned int c = cloth->indices[3 * f + k];
+            if (c != i && find(out.begin(), out.end(), c) == out.end()) out.push_back(c);
+        }
+    }
+}
+
+float Remesher::splitScore(uint64_t edgeKey, const Edge& edge) {
+    if (edge.count > 2) return 0.0f;
+    unsigned int a = (unsigned int) (edgeKey >> 32), b = (unsigned int) edgeKey;
+
+    // an edge halved REMESH_LEVELS times is as fine as it gets, whatever the mesh it started from
+    float rest = glm::length(cloth->restPositions[a] - cloth->restPositions[b]);
+    if (rest <= 1.8f * minLength) return 0.0f;
+
+    float folded = bend(edge) / (1.0f - cos(REMESH_SPLIT_ANGLE));
+    float strained = fabs(glm::length(cloth->positions[a] - cloth->positions[b]) / rest - 1.0f) / REMESH_STRAIN;
+    float score = glm::max(folded, strained);
+    return score > 1.0f ? score : 0.0f;
+}
+
+uint64_t Remesher::longestEdge(uint64_t edgeKey) {
+    const vector<glm::vec3>& rest = cloth->restPositions;
+    while (true) {
+        const Edge& edge = edges[edgeKey];
+        uint64_t next = edgeKey;
+        float longest = glm::length(rest[edgeKey >> 32] - rest[(unsigned int) edgeKey]) * 1.0001f;
+        for (unsigned int s = 0; s < edge.count && s < 2; s++) {
+            const unsigned int* corners = &cloth->indices[3 * edge.faces[s]];
+            for (unsigned int k = 0; k < 3; k++) {
+                float l = glm::length(rest[corners[k]] - rest[corners[(k + 1) % 3]]);
+                if (l <= longest) continue;
+                longest = l;
+                next = key(corners[k], corners[(k + 1) % 3]);
+            }
+        }
+        if (next == edgeKey) return edgeKey;
+        edgeKey = next;
+    }
+}
+
+bool Remesher::split(unsigned int a, unsigned int b) {
+    Edge edge = edges[key(a, b)];
+    vector<Particle*>& particles = cloth->particles;
+    vector<Triangle*>& triangles = cloth->triangles;
+    vector<unsigned int>& indices = cloth->indices;
+    Particle* pa = particles[a];
+    Particle* pb = particles[b];
+    if (pa->fixed && pb->fixed) return false;
+
+    // both triangles halve: the new particle takes a third of their area, a and b give up a sixth each
+    unsigned int corners[2];
+    float faceArea = 0.0f;
+    for (unsigned int s = 0; s < edge.count; s++) {
+        corners[s] = opposite(edge.faces[s], a, b);
+        faceArea += restArea(edge.faces[s]);
+    }
+    float mass = density * faceArea / 3.0f;
+    if (!stable(mass, 2 + edge.count)) return false;
+    if (!pa->fixed && !stable(pa->m - density * faceArea / 6.0f, vertexFaces[a].size() + 1)) return false;
+    if (!pb->fixed && !stable(pb->m - density * faceArea / 6.0f, vertexFaces[b].size() + 1)) return false;
+    for (unsigned int s = 0; s < edge.count; s++) {
+        // the corners keep their mass and gain an edge
+        Particle* pc = particles[corners[s]];
+        if (!pc->fixed && !stable(pc->m, vertexFaces[corners[s]].size() + 2)) return false;
+    }
+
+    for (unsigned int s = 0; s < edge.count; s++) {
+        addArea(edge.faces[s], -1.0f);
+    }
+
+    // the new particle halfway along the edge, moving with both ends
+    unsigned int m = (unsigned int) particles.size();
+    glm::vec3 p = 0.5f * (pa->p + pb->p);
+    Particle* pm;
+    if (freeParticles.empty()) {
+        pm = cloth->arena.create<Particle>(p.x, p.y, p.z, mass);
+    }
+    else {
+        pm = freeParticles.back();
+        freeParticles.pop_back();
+        *pm = Particle(p.x, p.y, p.z, mass);
+    }
+    pm->v = 0.5f * (pa->v + pb->v);
+    particles.push_back(pm);
+    cloth->positions.push_back(p);
+    cloth->normals.push_back(glm::vec3(0.0f));
+    cloth->restPositions.push_back(0.5f * (cloth->restPositions[a] + cloth->restPositions[b]));
+    cloth->originalId.push_back(m);
+    area.push_back(0.0f);
+    refined.push_back(1);
+    vertexFaces.push_back(vector<unsigned int>());
+
+    // each triangle keeps a and takes m for b; a new one with the same winding takes b and m
+    unsigned int added[2] = {UINT32_MAX, UINT32_MAX};
+    for (unsigned int s = 0; s < edge.count; s++) {
+        unsigned int f = edge.faces[s], c = corners[s];
+        unsigned int g = (unsigned int) triangles.size();
+        unsigned int kept[3], half[3];
+        for (unsigned int k = 0; k < 3; k++) {
+            unsigned int corner = indices[3 * f + k];
+            kept[k] = corner == b ? m : corner;
+            half[k] = corner == a ? m : corner;
+        }
+        Triangle* t;
+        if (freeTriangles.empty()) {
+            t = cloth->arena.create<Triangle>(particles[half[0]], particles[half[1]], particles[half[2]]);
+        }
+        else {
+            t = freeTriangles.back();
+            freeTriangles.pop_back();
+            *t = Triangle(particles[half[0]], particles[half[1]], particles[half[2]]);
+        }
+        triangles.push_back(t);
+        indices.insert(indices.end(), half, half + 3);
+        setCorners(f, kept);
+
+        replace(vertexFaces[b].begin(), vertexFaces[b].end(), f, g);
+        vertexFaces[c].push_back(g);
+        vertexFaces[m].push_back(f);
+        vertexFaces[m].push_back(g);
+        Edge& bc = edges[key(b, c)];
+        for (unsigned int k = 0; k < 2; k++) {
+            if (bc.faces[k] == f) bc.faces[k] = g;
+        }
+        float l = glm::length(cloth->restPositions[m] - cloth->restPositions[c]);
+        edges[key(m, c)] = Edge{{f, g}, 2, addSpring(pm, particles[c], l, cloth->Ks, true), NULL};
+        added[s] = g;
+    }
+
+    // the spring of the edge stays with its half at a, the half at b gets a new one
+    float l = glm::length(cloth->restPositions[m] - cloth->restPositions[a]);
+    edges.erase(key(a, b));
+    edge.spring->p1 = pa;
+    edge.spring->p2 = pm;
+    edge.spring->l = l;
+    edges[key(a, m)] = edge;
+    edges[key(m, b)] = Edge{{added[0], added[1]}, edge.count, addSpring(pm, pb, l, cloth->Ks, true), NULL};
+
+    for (unsigned int f : vertexFaces[m]) {
+        addArea(f, 1.0f);
+        triangles[f]->computeNormal();
+    }
+    for (unsigned int f : vertexFaces[m]) {
+        for (unsigned int k = 0; k < 3; k++) {
+            updateBend(indices[3 * f + k], indices[3 * f + (k + 1) % 3]);
+        }
+    }
+    updateMass(a);
+    updateMass(b);
+    updateMass(m);
+    for (unsigned int s = 0; s < edge.count; s++) {
+        updateMass(corners[s]);
+    }
+    return true;
+}
+
+bool Remesher::collapsible(unsigned int a, unsigned int& b) {
+    if (!refined[a] || cloth->particles[a]->fixed) return false;
+
+    vector<unsigned int> around;
+    neighbours(a, around);
+    float flat = 1.0f - cos(REMESH_FLAT_ANGLE);
+    float shortest = FLT_MAX;
+    for (unsigned int x : around) {
+        auto found = edges.find(key(a, x));
+        if (found == edges.end() || found->second.count > 2 || bend(found->second) > flat) return false;
+        float rest = glm::length(cloth->restPositions[a] - cloth->restPositions[x]);
+        float len = glm::length(cloth->positions[a] - cloth->positions[x]);
+        if (fabs(len / rest - 1.0f) > 0.5f * REMESH_STRAIN) return false;
+        if (rest < shortest) {
+            shortest = rest;
+            b = x;
+        }
+    }
+    return !around.empty();
+}
+
+bool Remesher::collapse(unsigned int a, unsigned int b) {
+    Edge edge = edges[key(a, b)];
+    vector<Particle*>& particles = cloth->particles;
+    vector<unsigned int>& indices = cloth->indices;
+    const vector<glm::vec3>& rest = cloth->restPositions;
+    const vector<glm::vec3>& positions = cloth->positions;
+    if (edge.count > 2) return false;
+
+    // a particle on the boundary may only slide along it, or the boundary would be pinched
+    vector<unsigned int> aroundA, aroundB;
+    neighbours(a, aroundA);
+    neighbours(b, aroundB);
+    bool boundary = false;
+    for (unsigned int x : aroundA) {
+        const Edge& e = edges[key(a, x)];
+        if (e.count > 2) return false;
+        if (e.count == 1) boundary = true;
+    }
+    if (boundary && edge.count != 1) return false;
+
+    // link condition: a and b share no neighbour but the corners opposite their edge
+    unsigned int corners[2] = {UINT32_MAX, UINT32_MAX};
+    for (unsigned int s = 0; s < edge.count; s++) {
+        corners[s] = opposite(edge.faces[s], a, b);
+        if (edges[key(b, corners[s])].count > 2) return false;
+    }
+    for (unsigned int x : aroundA) {
+        if (x == b || find(aroundB.begin(), aroundB.end(), x) == aroundB.end()) continue;
+        if (x != corners[0] && x != corners[1]) return false;
+    }
+
+    // no triangle moving from a to b may turn over, at rest or now, and no edge may get coarser than the loaded mesh
+    for (unsigned int f : vertexFaces[a]) {
+        if (f == edge.faces[0] || f == edge.faces[1]) continue;
+        const unsigned int* c = &indices[3 * f];
+        unsigned int moved[3];
+        for (unsigned int k = 0; k < 3; k++) {
+            moved[k] = c[k] == a ? b : c[k];
+        }
+        glm::vec3 restBefore = glm::cross(rest[c[1]] - rest[c[0]], rest[c[2]] - rest[c[0]]);
+        glm::vec3 restAfter = glm::cross(rest[moved[1]] - rest[moved[0]], rest[moved[2]] - rest[moved[0]]);
+        glm::vec3 before = glm::cross(positions[c[1]] - positions[c[0]], positions[c[2]] - positions[c[0]]);
+        glm::vec3 after = glm::cross(positions[moved[1]] - positions[moved[0]], positions[moved[2]] - positions[moved[0]]);
+        if (glm::dot(restBefore, restAfter) <= 0.0f || glm::dot(before, after) <= 0.0f) return false;
+    }
+    for (unsigned int x : aroundA) {
+        if (glm::length(rest[b] - rest[x]) > 2.0f * cloth->offset) return false;
+    }
+
+    // b takes a's edges but for the shared ones, and about a's mass
+    Particle* pa = particles[a];
+    Particle* pb = particles[b];
+    if (!pb->fixed && !stable(pa->m + pb->m, aroundA.size() + aroundB.size() - 2 - edge.count)) return false;
+    if (!pb->fixed) pb->v = (pa->m * pa->v + pb->m * pb->v) / (pa->m + pb->m);
+    for (unsigned int f : vertexFaces[a]) {
+        addArea(f, -1.0f);
+    }
+
+    // the edge to b goes, the edges to the corners merge into b's, the others move over to b
+    for (unsigned int x : aroundA) {
+        auto found = edges.find(key(a, x));
+        Edge e = found->second;
+        edges.erase(found);
+        int s = x == corners[0] ? 0 : (x == corners[1] ? 1 : -1);
+        if (x == b || s >= 0) {
+            droppedSprings.push_back(e.spring);
+            if (e.bend) droppedSprings.push_back(e.bend);
+        }
+        if (x == b) continue;
+        if (s >= 0) {
+            Edge& merged = edges[key(b, x)];
+            unsigned int removed = edge.faces[s];
+            unsigned int faces[2] = {merged.faces[0] == removed ? merged.faces[1] : merged.faces[0],
+                                     e.faces[0] == removed ? e.faces[1] : e.faces[0]};
+            merged.faces[0] = merged.faces[1] = UINT32_MAX;
+            merged.count = 0;
+            for (unsigned int f : faces) {
+                if (f != UINT32_MAX) merged.faces[merged.count++] = f;
+            }
+            continue;
+        }
+        if (e.spring->p1 == pa) e.spring->p1 = pb;
+        else e.spring->p2 = pb;
+        e.spring->l = glm::length(rest[b] - rest[x]);
+        edges[key(b, x)] = e;
+    }
+
+    for (unsigned int f : vertexFaces[a]) {
+        if (f == edge.faces[0] || f == edge.faces[1]) continue;
+        unsigned int moved[3];
+        for (unsigned int k = 0; k < 3; k++) {
+            moved[k] = indices[3 * f + k] == a ? b : indices[3 * f + k];
+        }
+        setCorners(f, moved);
+        vertexFaces[b].push_back(f);
+        addArea(f, 1.0f);
+    }
+
+    // the later slot first, so filling it does not move the other triangle
+    unsigned int removed[2] = {edge.faces[0], edge.faces[1]};
+    if (edge.count == 2 && removed[0] < removed[1]) swap(removed[0], removed[1]);
+    for (unsigned int s = 0; s < edge.count; s++) {
+        removeFace(removed[s]);
+    }
+    vertexFaces[a].clear();
+
+    for (unsigned int f : vertexFaces[b]) {
+        cloth->triangles[f]->computeNormal();
+    }
+    for (unsigned int f : vertexFaces[b]) {
+        for (unsigned int k = 0; k < 3; k++) {
+            updateBend(indices[3 * f + k], indices[3 * f + (k + 1) % 3]);
+        }
+    }
+    updateMass(b);
+    for (unsigned int x : aroundA) {
+        updateMass(x);
+    }
+    removeParticle(a);
+    return true;
+}
+
+bool Remesher::update() {
+    if (++frame < REMESH_INTERVAL) return false;
+    frame = 0;
+    return remesh();
+}
+
+bool Remesher::remesh() {
+    unsigned int budget = REMESH_BUDGET;
+    bool changed = false;
+
+    // splits, the most bent or strained edges first; splits only add, so indices stay valid
+    vector<pair<float, uint64_t>> candidates;
+    for (const auto& entry : edges) {
+        float score = splitScore(entry.first, entry.second);
+        if (score > 0.0f) candidates.push_back(make_pair(score, entry.first));
+    }
+    sort(candidates.begin(), candidates.end(), greater<pair<float, uint64_t>>());
+    for (const pair<float, uint64_t>& candidate : candidates) {
+        // longer edges of the triangles around go first, the candidate follows once it is the longest;
+        // an earlier split may have halved the edge or flattened it
+        while (budget > 0) {
+            auto found = edges.find(candidate.second);
+            if (found == edges.end() || splitScore(found->first, found->second) <= 0.0f) break;
+            uint64_t target = longestEdge(candidate.second);
+            if (!split((unsigned int) (target >> 32), (unsigned int) target)) break;
+            budget--;
+            changed = true;
+        }
+    }
+
+    // collapses from the last particle down, so whatever fills a freed slot has been looked at
+    for (unsigned int i = (unsigned int) cloth->particles.size(); i-- > 0 && budget > 0;) {
+        unsigned int b;
+        if (!collapsible(i, b) || !collapse(i, b)) continue;
+        budget--;
+        changed = true;
+    }
+    if (!changed) return false;
+
+    // dropped springs leave the cloth's list in one sweep
+    sort(droppedSprings.begin(), droppedSprings.end());
+    vector<SpringDamper*>& springs = cloth->springDampers;
+    springs.erase(remove_if(springs.begin(), springs.end(), [this](SpringDamper* s) {
+        return binary_search(droppedSprings.begin(), droppedSprings.end(), s);
+    }), springs.end());
+    freeSprings.insert(freeSprings.end(), droppedSprings.begin(), droppedSprings.end());
+    droppedSprings.clear();
+    cloth->width = (unsigned int) cloth->particles.size();
+    return true;
+}
@@ -0,0 +1,126 @@
+//
+//  Remesher.hpp
+//
+
+#ifndef Remesher_hpp
+#define Remesher_hpp
+
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+#include <unordered_map>
+
+#include "Particle.hpp"
+#include "SpringDamper.hpp"
+#include "Triangle.hpp"
+
+#define REMESH_INTERVAL     10      // frames between two passes
+#define REMESH_LEVELS       3       // times an edge of the loaded mesh may be halved
+#define REMESH_SPLIT_ANGLE  0.35f   // bend across an edge (rad) above which it is split
+#define REMESH_FLAT_ANGLE   0.1f    // bend every edge around a particle stays under for it to be collapsed (rad)
+#define REMESH_STRAIN       0.5f    // stretch or compression of an edge above which it is split
+#define REMESH_SAFETY       0.8f    // share of the explicit stability limit a refined particle may reach
+#define REMESH_BUDGET       4096    // splits and collapses per pass, the rest wait for the next one
+
+using namespace std;
+
+class Cloth;
+
+// Adaptive remeshing of a cloth built from triangles, such as a loaded mesh.
+// Edges that fold sharply or stretch far are split at their midpoint, which
+// halves the two triangles on them, after the longer edges around them so the
+// triangles do not grow thin (Rivara's longest-edge bisection); particles added that way are collapsed
+// into a neighbour again once the cloth around them lies flat. Particles carry
+// the rest area around them at the cloth's density, so mass follows the mesh.
+// State moves with the topology: a new particle takes the mean position and
+// velocity of the edge, a collapsed one hands its momentum to the particle it
+// merges into. Edges, the faces around each particle and the springs are kept
+// up to date operation by operation, so a pass costs time in the edges it
+// changes plus one scan for candidates. Particles and triangles are removed by
+// moving the last one into their slot. In explicit integration a split that
+// would make a particle too light for TIME_STEP is skipped.
+class Remesher {
+private:
+    struct Edge {
+        unsigned int faces[2];  // triangles on the edge, UINT32_MAX past count
+        unsigned int count;     // triangles seen on the edge, more than two lock it
+        SpringDamper* spring;
+        SpringDamper* bend;     // between the corners opposite the edge, NULL unless two triangles share it
+    };
+
+    Cloth* cloth;
+    unordered_map<uint64_t, Edge> edges;
+    vector<vector<unsigned int>> vertexFaces;   // triangles around each particle
+    vector<float> area;                         // rest area lumped to each particle
+    vector<unsigned char> refined;              // 1 for particles the remesher added
+    float density;                              // mass per rest area
+    float minLength;                            // rest length of an edge halved REMESH_LEVELS times
+    unsigned int frame;                         // frames since the last pass
+
+    // springs dropped during a pass leave the cloth's list at its end, and are reused from then on
+    vector<SpringDamper*> droppedSprings;
+    vector<SpringDamper*> freeSprings;
+    vector<Particle*> freeParticles;
+    vector<Triangle*> freeTriangles;
+
+    static uint64_t key(unsigned int a, unsigned int b) {
+        return a < b ? ((uint64_t) a << 32) | b : ((uint64_t) b << 32) | a;
+    }
+
+    // corner of a triangle that is neither a nor b
+    unsigned int opposite(unsigned int face, unsigned int a, unsigned int b);
+
+    // 1 - cos of the angle between the triangles on an edge, 0 on the boundary
+    float bend(const Edge& edge);
+
+    float restArea(unsigned int face);
+
+    void addArea(unsigned int face, float sign);
+
+    void updateMass(unsigned int i);
+
+    // explicit integration keeps a particle of this mass and edge count stable
+    bool stable(float mass, size_t edgeCount);
+
+    SpringDamper* addSpring(Particle* p1, Particle* p2, float l, float Ks, bool stretch);
+
+    // point the bend spring of the edge at its two opposite corners, adding or dropping it as needed
+    void updateBend(unsigned int a, unsigned int b);
+
+    void setCorners(unsigned int face, const unsigned int* corners);
+
+    // take a triangle out of the faces around its corners and the edges, then fill its slot with the last one
+    void removeFace(unsigned int face);
+
+    // fill the slot of a particle no triangle uses any more with the last one
+    void removeParticle(unsigned int i);
+
+    void neighbours(unsigned int i, vector<unsigned int>& out);
+
+    // how far past the split thresholds an edge is bent or strained, 0 if it stays
+    float splitScore(uint64_t edgeKey, const Edge& edge);
+
+    // longest-edge bisection: from an edge on to the longest edge of the triangles on it, until that is the
+    // edge itself; splitting there first halves triangles along their long side, so they keep their shape
+    uint64_t longestEdge(uint64_t edgeKey);
+
+    bool split(unsigned int a, unsigned int b);
+
+    // merge a into b along their edge; false if that would fold, pinch or lock the mesh
+    bool collapse(unsigned int a, unsigned int b);
+
+    // a refined particle whose edges all lie flat and unstrained, and the neighbour to merge it into
+    bool collapsible(unsigned int a, unsigned int& b);
+
+public:
+    // takes the cloth's current particle order as its build order from here on
+    Remesher(Cloth* cloth);
+
+    // a pass every REMESH_INTERVAL frames; true if the topology changed
+    bool update();
+
+    // split the bent and strained edges, then collapse the flat particles; true if the topology changed
+    bool remesh();
+};
+
+#endif /* Remesher_hpp */
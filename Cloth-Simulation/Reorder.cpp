@@ -0,0 +1,112 @@
+//
+//  Reorder.cpp
+//
+
+#include "Reorder.hpp"
+
+#include <algorithm>
+#include <string.h>
+
+// spread the low 10 bits of v so there are two zero bits between each
+static uint32_t spreadBits(uint32_t v) {
+    v &= 0x3ff;
+    v = (v | (v << 16)) & 0x030000ff;
+    v = (v | (v << 8)) & 0x0300f00f;
+    v = (v | (v << 4)) & 0x030c30c3;
+    v = (v | (v << 2)) & 0x09249249;
+    return v;
+}
+
+vector<unsigned int> Reorder::morton(const vector<glm::vec3>& points) {
+    glm::vec3 lo(0.0f), hi(0.0f);
+    if (!points.empty()) {
+        lo = hi = points[0];
+    }
+    for (const glm::vec3& p : points) {
+        lo = glm::min(lo, p);
+        hi = glm::max(hi, p);
+    }
+    glm::vec3 extent = hi - lo;
+    float scale = 1023.0f / glm::max(glm::max(extent.x, extent.y), glm::max(extent.z, 1e-6f));
+
+    // 10 bits per axis of the position in the bounding box, interleaved
+    vector<pair<uint32_t, unsigned int>> codes(points.size());
+    for (unsigned int i = 0; i < points.size(); i++) {
+        glm::vec3 q = (points[i] - lo) * scale;
+        uint32_t code = spreadBits((uint32_t) q.x) | (spreadBits((uint32_t) q.y) << 1) | (spreadBits((uint32_t) q.z) << 2);
+        codes[i] = make_pair(code, i);
+    }
+    sort(codes.begin(), codes.end());
+
+    vector<unsigned int> order(points.size());
+    for (unsigned int i = 0; i < codes.size(); i++) {
+        order[i] = codes[i].second;
+    }
+    return order;
+}
+
+vector<unsigned int> Reorder::reverseCuthillMcKee(unsigned int n, const vector<pair<unsigned int, unsigned int>>& edges) {
+    // adjacency in compressed rows
+    vector<unsigned int> start(n + 1, 0);
+    for (const pair<unsigned int, unsigned int>& e : edges) {
+        start[e.first + 1]++;
+        start[e.second + 1]++;
+    }
+    for (unsigned int i = 0; i < n; i++) {
+        start[i + 1] += start[i];
+    }
+    vector<unsigned int> adjacent(start[n]);
+    vector<unsigned int> fill(start.begin(), start.end() - 1);
+    for (const pair<unsigned int, unsigned int>& e : edges) {
+        adjacent[fill[e.first]++] = e.second;
+        adjacent[fill[e.second]++] = e.first;
+    }
+    auto degree = [&start](unsigned int i) { return start[i + 1] - start[i]; };
+
+    // breadth first from a lowest degree vertex of each component, neighbours by increasing degree
+    vector<unsigned int> byDegree(n);
+    for (unsigned int i = 0; i < n; i++) {
+        byDegree[i] = i;
+    }
+    stable_sort(byDegree.begin(), byDegree.end(), [&degree](unsigned int a, unsigned int b) { return degree(a) < degree(b); });
+
+    vector<unsigned int> order;
+    order.reserve(n);
+    vector<bool> visited(n, false);
+    vector<unsigned int> neighbours;
+    for (unsigned int seed : byDegree) {
+        if (visited[seed]) continue;
+        visited[seed] = true;
+        order.push_back(seed);
+        for (size_t head = order.size() - 1; head < order.size(); head++) {
+            unsigned int v = order[head];
+            neighbours.clear();
+            for (unsigned int k = start[v]; k < start[v + 1]; k++) {
+                if (!visited[adjacent[k]]) {
+                    visited[adjacent[k]] = true;
+                    neighbours.push_back(adjacent[k]);
+                }
+            }
+            stable_sort(neighbours.begin(), neighbours.end(), [&degree](unsigned int a, unsigned int b) { return degree(a) < degree(b); });
+            order.insert(order.end(), neighbours.begin(), neighbours.end());
+        }
+    }
+
+    reverse(order.begin(), order.end());
+    return order;
+}
+
+float Reorder::meanEdgeSpan(const vector<pair<unsigned int, unsigned int>>& edges) {
+    if (edges.empty()) return 0.0f;
+    double sum = 0.0;
+    for (const pair<unsigned int, unsigned int>& e : edges) {
+        sum += e.first > e.second ? e.first - e.second : e.second - e.first;
+    }
+    return (float) (sum / edges.size());
+}
+
+ReorderMethod Reorder::parse(const char* name) {
+    if (strcmp(name, "morton") == 0) return REORDER_MORTON;
+    if (strcmp(name, "rcm") == 0) return REORDER_RCM;
+    return REORDER_NONE;
+}
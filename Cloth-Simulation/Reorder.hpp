@@ -0,0 +1,37 @@
+//
+//  Reorder.hpp
+//
+
+#ifndef Reorder_hpp
+#define Reorder_hpp
+
+#include <stdio.h>
+#include <vector>
+#include <utility>
+
+#include "Core.h"
+
+using namespace std;
+
+enum ReorderMethod {
+    REORDER_NONE,
+    REORDER_MORTON,     // sort along a Z-order curve through the bounding box
+    REORDER_RCM         // reverse Cuthill-McKee on the spring graph
+};
+
+// Permutations that put particles close in space or in the spring graph
+// close in memory. Every order maps a new index to the old one.
+class Reorder {
+public:
+    static vector<unsigned int> morton(const vector<glm::vec3>& points);
+
+    static vector<unsigned int> reverseCuthillMcKee(unsigned int n, const vector<pair<unsigned int, unsigned int>>& edges);
+
+    // mean index distance between the two ends of an edge, lower is better
+    static float meanEdgeSpan(const vector<pair<unsigned int, unsigned int>>& edges);
+
+    // parse "morton" or "rcm", REORDER_NONE for anything else
+    static ReorderMethod parse(const char* name);
+};
+
+#endif /* Reorder_hpp */
@@ -0,0 +1,42 @@
+//
+//  SceneLoader.cpp
+//
+
+#include "SceneLoader.hpp"
+
+#include "Tracer.hpp"
+
+SceneLoader::SceneLoader() : ready(false), scene(0), built(NULL) {}
+
+bool SceneLoader::start(int scene, const function<Cloth*()>& build) {
+    if (isBusy()) return false;
+    
+    this->scene = scene;
+    built = NULL;
+    ready = false;
+    worker = thread([this, build] {
+        Tracer::setThreadName("loader");
+        TRACE_SCOPE("build scene");
+        built = build();
+        ready = true; // publishes built to the main thread
+    });
+    return true;
+}
+
+Cloth* SceneLoader::take() {
+    if (!isBusy()) return NULL;
+    
+    worker.join();
+    Cloth* cloth = built;
+    built = NULL;
+    ready = false;
+    return cloth;
+}
+
+void SceneLoader::cancel() {
+    delete take(); // never uploaded, so no GL objects to free
+}
+
+SceneLoader::~SceneLoader() {
+    cancel();
+}
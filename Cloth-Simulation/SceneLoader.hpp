@@ -0,0 +1,49 @@
+//
+//  SceneLoader.hpp
+//
+
+#ifndef SceneLoader_hpp
+#define SceneLoader_hpp
+
+#include <stdio.h>
+#include <atomic>
+#include <functional>
+#include <thread>
+
+#include "Cloth.hpp"
+
+#define SCENE_UPLOAD_BUDGET (1 << 20)   // bytes of a new cloth sent to the GPU per frame
+
+// Builds the cloth of a scene on a worker thread while the current scene keeps
+// running. The build must not touch OpenGL, the thread pool or the profiler, so
+// it must not step a cloth; the owner uploads the buffers and swaps the cloth in
+// on the main thread once isReady() says it is done.
+class SceneLoader {
+private:
+    thread worker;
+    atomic<bool> ready;
+    int scene;
+    Cloth* built;
+
+public:
+    SceneLoader();
+
+    // start building a scene, false if a build is still running or unclaimed
+    bool start(int scene, const function<Cloth*()>& build);
+
+    bool isBusy() { return worker.joinable(); }
+
+    bool isReady() { return ready; }
+
+    int getScene() { return scene; }
+
+    // hand over the finished cloth (NULL if the build failed) and free the loader
+    Cloth* take();
+
+    // wait for the worker and drop its result
+    void cancel();
+
+    ~SceneLoader();
+};
+
+#endif /* SceneLoader_hpp */
@@ -9,12 +9,13 @@
 
 SpringDamper::SpringDamper() {}
 
-SpringDamper::SpringDamper(Particle* p1, Particle* p2, float l, float Ks, float Kd) {
+SpringDamper::SpringDamper(Particle* p1, Particle* p2, float l, float Ks, float Kd, bool stretch) {
     this->p1 = p1;
     this->p2 = p2;
     this->l = l;
     this->Ks = Ks;
     this->Kd = Kd;
+    this->stretch = stretch;
 }
 
 void SpringDamper::applyForce() {
@@ -32,4 +33,21 @@ void SpringDamper::applyForce() {
     p2->applyForce(f2);
 }
 
+void SpringDamper::limitStretch(float maxLength, float deltaTime) {
+    glm::vec3 e = p2->p - p1->p;
+    float eLen = glm::length(e);
+    if (!(eLen > maxLength)) return;
+    
+    // fixed particles do not move
+    float w1 = p1->fixed ? 0.0f : 1.0f / p1->m;
+    float w2 = p2->fixed ? 0.0f : 1.0f / p2->m;
+    if (w1 + w2 == 0.0f) return;
+    
+    glm::vec3 move = ((eLen - maxLength) / (eLen * (w1 + w2))) * e;
+    p1->p += w1 * move;
+    p2->p -= w2 * move;
+    p1->v += (w1 / deltaTime) * move;
+    p2->v -= (w2 / deltaTime) * move;
+}
+
 SpringDamper::~SpringDamper() {}
@@ -17,15 +17,20 @@ public:
     float Ks;   // spring constant
     float Kd;   // damping factor
     float l;    // rest length
+    bool stretch;   // structural or shear, shortened by the strain limit; false for bend springs
     Particle * p1;
     Particle * p2;
     
     SpringDamper();
     
-    SpringDamper(Particle* p1, Particle* p2, float l, float Ks, float Kd);
+    SpringDamper(Particle* p1, Particle* p2, float l, float Ks, float Kd, bool stretch);
     
     void applyForce();
     
+    // pull the ends together, by inverse mass, if the spring is longer than maxLength;
+    // the move goes into the velocities too so the next step does not undo it
+    void limitStretch(float maxLength, float deltaTime);
+    
     ~SpringDamper();
     
 };
@@ -0,0 +1,370 @@
+//
+//  Subspace.cpp
+//
+
+#include "Subspace.hpp"
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+Gusts::Gusts(glm::vec3 mean, glm::vec3 spread, uint32_t seed) {
+    this->mean = mean;
+    this->spread = spread;
+    this->state = seed * 747796405u + 2891336453u;
+    if (state == 0) state = 1;
+    this->frame = 0;
+    to = mean + spread * glm::vec3(random(), random(), random());
+    from = to;
+}
+
+float Gusts::random() {
+    // xorshift32
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return (float) (state * (2.0 / 4294967296.0) - 1.0);
+}
+
+glm::vec3 Gusts::next() {
+    unsigned int phase = frame % GUST_FRAMES;
+    if (phase == 0) {
+        from = to;
+        to = mean + spread * glm::vec3(random(), random(), random());
+    }
+    float s = (float) phase / GUST_FRAMES;
+    frame++;
+    return glm::mix(from, to, s * s * (3.0f - 2.0f * s));
+}
+
+// Gram-Schmidt, twice per column for accuracy, on a column-major matrix; a column that
+// depends on the earlier ones is left zero
+static void orthonormalize(vector<double>& m, size_t rows, unsigned int cols) {
+    for (unsigned int j = 0; j < cols; j++) {
+        double* cj = &m[j * rows];
+        for (unsigned int pass = 0; pass < 2; pass++) {
+            for (unsigned int i = 0; i < j; i++) {
+                const double* ci = &m[i * rows];
+                double d = 0.0;
+                for (size_t r = 0; r < rows; r++) d += ci[r] * cj[r];
+                for (size_t r = 0; r < rows; r++) cj[r] -= d * ci[r];
+            }
+        }
+        double norm = 0.0;
+        for (size_t r = 0; r < rows; r++) norm += cj[r] * cj[r];
+        norm = sqrt(norm);
+        double scale = norm > 1e-12 ? 1.0 / norm : 0.0;
+        for (size_t r = 0; r < rows; r++) cj[r] *= scale;
+    }
+}
+
+// cyclic Jacobi on a symmetric n x n matrix: the eigenvalues end up on its diagonal, the
+// eigenvectors in the columns of vectors
+static void jacobiEigen(vector<double>& a, unsigned int n, vector<double>& vectors) {
+    vectors.assign(n * n, 0.0);
+    for (unsigned int i = 0; i < n; i++) vectors[i * n + i] = 1.0;
+
+    for (unsigned int sweep = 0; sweep < 64; sweep++) {
+        double off = 0.0, diagonal = 0.0;
+        for (unsigned int p = 0; p < n; p++) {
+            diagonal += a[p * n + p] * a[p * n + p];
+            for (unsigned int q = p + 1; q < n; q++) off += a[p * n + q] * a[p * n + q];
+        }
+        if (off <= 1e-24 * diagonal) break;
+
+        for (unsigned int p = 0; p < n; p++) {
+            for (unsigned int q = p + 1; q < n; q++) {
+                double apq = a[p * n + q];
+                if (apq == 0.0) continue;
+                double theta = (a[q * n + q] - a[p * n + p]) / (2.0 * apq);
+                double t = (theta >= 0.0 ? 1.0 : -1.0) / (fabs(theta) + sqrt(theta * theta + 1.0));
+                double c = 1.0 / sqrt(t * t + 1.0), s = t * c;
+                for (unsigned int k = 0; k < n; k++) {
+                    double akp = a[k * n + p], akq = a[k * n + q];
+                    a[k * n + p] = c * akp - s * akq;
+                    a[k * n + q] = s * akp + c * akq;
+                }
+                for (unsigned int k = 0; k < n; k++) {
+                    double apk = a[p * n + k], aqk = a[q * n + k];
+                    a[p * n + k] = c * apk - s * aqk;
+                    a[q * n + k] = s * apk + c * aqk;
+                }
+                for (unsigned int k = 0; k < n; k++) {
+                    double vkp = vectors[k * n + p], vkq = vectors[k * n + q];
+                    vectors[k * n + p] = c * vkp - s * vkq;
+                    vectors[k * n + q] = s * vkp + c * vkq;
+                }
+            }
+        }
+    }
+}
+
+// a x = b for a symmetric positive definite n x n matrix and cols right hand sides, b row-major; x replaces b
+static bool choleskySolve(vector<double>& a, vector<double>& b, unsigned int n, unsigned int cols) {
+    for (unsigned int i = 0; i < n; i++) {
+        for (unsigned int j = 0; j <= i; j++) {
+            double sum = a[i * n + j];
+            for (unsigned int k = 0; k < j; k++) sum -= a[i * n + k] * a[j * n + k];
+            if (j < i) {
+                a[i * n + j] = sum / a[j * n + j];
+            }
+            else if (sum > 0.0) {
+                a[i * n + i] = sqrt(sum);
+            }
+            else {
+                return false;
+            }
+        }
+    }
+    for (unsigned int c = 0; c < cols; c++) {
+        for (unsigned int i = 0; i < n; i++) {
+            double sum = b[i * cols + c];
+            for (unsigned int k = 0; k < i; k++) sum -= a[i * n + k] * b[k * cols + c];
+            b[i * cols + c] = sum / a[i * n + i];
+        }
+        for (unsigned int i = n; i-- > 0;) {
+            double sum = b[i * cols + c];
+            for (unsigned int k = i + 1; k < n; k++) sum -= a[k * n + i] * b[k * cols + c];
+            b[i * cols + c] = sum / a[i * n + i];
+        }
+    }
+    return true;
+}
+
+Subspace* Subspace::train(Cloth* cloth, Gusts& gusts, unsigned int warmup, unsigned int frames) {
+    if (frames < 3) return NULL;
+    for (unsigned int f = 0; f < warmup; f++) {
+        cloth->setWind(gusts.next());
+        cloth->update();
+    }
+
+    // one snapshot per frame, with the wind that moves it on to the next
+    const vector<glm::vec3>& positions = cloth->getPositions();
+    size_t dimension = 3 * positions.size();
+    vector<float> snapshots(frames * dimension);
+    vector<glm::vec3> winds(frames);
+    for (unsigned int f = 0; f < frames; f++) {
+        memcpy(&snapshots[f * dimension], positions.data(), dimension * sizeof(float));
+        winds[f] = gusts.next();
+        cloth->setWind(winds[f]);
+        cloth->update();
+    }
+
+    Subspace* subspace = new Subspace();
+    subspace->dimension = (unsigned int) dimension;
+    subspace->indices = cloth->indices;
+    vector<double> mean(dimension, 0.0);
+    for (unsigned int f = 0; f < frames; f++) {
+        for (size_t d = 0; d < dimension; d++) mean[d] += snapshots[f * dimension + d];
+    }
+    subspace->mean.resize(dimension);
+    for (size_t d = 0; d < dimension; d++) {
+        mean[d] /= frames;
+        subspace->mean[d] = (float) mean[d];
+    }
+    double total = 0.0;
+    for (unsigned int f = 0; f < frames; f++) {
+        float* x = &snapshots[f * dimension];
+        for (size_t d = 0; d < dimension; d++) {
+            x[d] -= (float) mean[d];
+            total += (double) x[d] * x[d];
+        }
+    }
+
+    // randomized range finder: Y = X Omega for a random Omega, then Y = X X^T Y a few times so
+    // the modes with the largest variance dominate Y, all with orthonormal columns
+    unsigned int k = glm::min((unsigned int) SUBSPACE_MODES + SUBSPACE_OVERSAMPLE, frames);
+    vector<double> y(dimension * k, 0.0), z(frames * k);
+    uint32_t state = 2463534242u;
+    for (double& w : z) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        w = state * (2.0 / 4294967296.0) - 1.0;
+    }
+    for (unsigned int pass = 0; pass <= SUBSPACE_POWER; pass++) {
+        if (pass > 0) {
+            orthonormalize(y, dimension, k);
+            for (unsigned int j = 0; j < k; j++) {
+                for (unsigned int f = 0; f < frames; f++) {
+                    const float* x = &snapshots[f * dimension];
+                    double d = 0.0;
+                    for (size_t r = 0; r < dimension; r++) d += x[r] * y[j * dimension + r];
+                    z[j * frames + f] = d;
+                }
+            }
+            orthonormalize(z, frames, k);
+            fill(y.begin(), y.end(), 0.0);
+        }
+        for (unsigned int j = 0; j < k; j++) {
+            double* yj = &y[j * dimension];
+            for (unsigned int f = 0; f < frames; f++) {
+                double w = z[j * frames + f];
+                const float* x = &snapshots[f * dimension];
+                for (size_t r = 0; r < dimension; r++) yj[r] += w * x[r];
+            }
+        }
+    }
+    orthonormalize(y, dimension, k);
+
+    // B = Q^T X is small; the eigenvectors of B B^T turn Q into the principal modes
+    vector<double> b(k * frames);
+    for (unsigned int i = 0; i < k; i++) {
+        for (unsigned int f = 0; f < frames; f++) {
+            const float* x = &snapshots[f * dimension];
+            double d = 0.0;
+            for (size_t r = 0; r < dimension; r++) d += x[r] * y[i * dimension + r];
+            b[i * frames + f] = d;
+        }
+    }
+    vector<double> c(k * k, 0.0), vectors;
+    for (unsigned int i = 0; i < k; i++) {
+        for (unsigned int j = 0; j < k; j++) {
+            for (unsigned int f = 0; f < frames; f++) c[i * k + j] += b[i * frames + f] * b[j * frames + f];
+        }
+    }
+    jacobiEigen(c, k, vectors);
+    vector<unsigned int> order(k);
+    for (unsigned int i = 0; i < k; i++) order[i] = i;
+    sort(order.begin(), order.end(), [&c, k](unsigned int i, unsigned int j) { return c[i * k + i] > c[j * k + j]; });
+
+    unsigned int modes = glm::min((unsigned int) SUBSPACE_MODES, k);
+    subspace->modes = modes;
+    subspace->basis.assign(modes * dimension, 0.0f);
+    subspace->trajectory.assign(frames * modes, 0.0f);
+    double kept = 0.0;
+    for (unsigned int m = 0; m < modes; m++) {
+        unsigned int e = order[m];
+        kept += c[e * k + e];
+        for (unsigned int i = 0; i < k; i++) {
+            double v = vectors[i * k + e];
+            for (size_t r = 0; r < dimension; r++) subspace->basis[m * dimension + r] += (float) (v * y[i * dimension + r]);
+            for (unsigned int f = 0; f < frames; f++) subspace->trajectory[f * modes + m] += (float) (v * b[i * frames + f]);
+        }
+    }
+    subspace->captured = total > 0.0 ? (float) (kept / total) : 1.0f;
+
+    subspace->lower.assign(modes, 0.0f);
+    subspace->upper.assign(modes, 0.0f);
+    for (unsigned int m = 0; m < modes; m++) {
+        float lo = subspace->trajectory[m], hi = lo;
+        for (unsigned int f = 1; f < frames; f++) {
+            lo = glm::min(lo, subspace->trajectory[f * modes + m]);
+            hi = glm::max(hi, subspace->trajectory[f * modes + m]);
+        }
+        subspace->lower[m] = lo - SUBSPACE_MARGIN * (hi - lo);
+        subspace->upper[m] = hi + SUBSPACE_MARGIN * (hi - lo);
+    }
+
+    // the least regularised dynamics that keeps to the training range, heavily damped ones otherwise
+    double ridge = SUBSPACE_RIDGE;
+    while (!subspace->fit(winds, ridge) && ridge < 1.0) {
+        ridge *= 10.0;
+    }
+    return subspace;
+}
+
+bool Subspace::fit(const vector<glm::vec3>& winds, double ridge) {
+    unsigned int r = modes, n = 2 * modes + 4;
+    unsigned int frames = (unsigned int) (trajectory.size() / modes);
+    vector<double> w(n), normal(n * n, 0.0), rhs(n * r, 0.0);
+    for (unsigned int f = 1; f + 1 < frames; f++) {
+        for (unsigned int m = 0; m < r; m++) {
+            w[m] = trajectory[f * r + m];
+            w[r + m] = trajectory[(f - 1) * r + m];
+        }
+        w[2 * r] = winds[f].x;
+        w[2 * r + 1] = winds[f].y;
+        w[2 * r + 2] = winds[f].z;
+        w[2 * r + 3] = 1.0;
+        for (unsigned int i = 0; i < n; i++) {
+            for (unsigned int j = 0; j < n; j++) normal[i * n + j] += w[i] * w[j];
+            for (unsigned int m = 0; m < r; m++) rhs[i * r + m] += w[i] * trajectory[(f + 1) * r + m];
+        }
+    }
+    double trace = 0.0;
+    for (unsigned int i = 0; i < n; i++) trace += normal[i * n + i];
+    for (unsigned int i = 0; i < n; i++) normal[i * n + i] += ridge * trace / n + 1e-12;
+    if (!choleskySolve(normal, rhs, n, r)) return false;
+    dynamics.assign(rhs.begin(), rhs.end());
+
+    // run the model on its own from the first frames under the training winds
+    float bound = 0.0f;
+    for (unsigned int f = 0; f < frames; f++) {
+        float norm = 0.0f;
+        for (unsigned int m = 0; m < r; m++) norm += trajectory[f * r + m] * trajectory[f * r + m];
+        bound = glm::max(bound, norm);
+    }
+    bound *= 9.0f; // three times the largest norm seen, squared
+    vector<float> q(trajectory.begin() + r, trajectory.begin() + 2 * r);
+    vector<float> previous(trajectory.begin(), trajectory.begin() + r), next(r);
+    for (unsigned int f = 1; f + 1 < frames; f++) {
+        advance(q.data(), previous.data(), winds[f], next.data());
+        float norm = 0.0f;
+        for (unsigned int m = 0; m < r; m++) norm += next[m] * next[m];
+        if (!(norm <= bound)) return false;
+        previous.swap(q);
+        q.swap(next);
+    }
+    return true;
+}
+
+void Subspace::advance(const float* q, const float* previous, glm::vec3 wind, float* next) {
+    unsigned int r = modes;
+    for (unsigned int m = 0; m < r; m++) next[m] = dynamics[(2 * r + 3) * r + m];
+    for (unsigned int j = 0; j < r; j++) {
+        const float* a = &dynamics[j * r];
+        const float* b = &dynamics[(r + j) * r];
+        for (unsigned int m = 0; m < r; m++) next[m] += q[j] * a[m] + previous[j] * b[m];
+    }
+    for (unsigned int c = 0; c < 3; c++) {
+        const float* a = &dynamics[(2 * r + c) * r];
+        for (unsigned int m = 0; m < r; m++) next[m] += wind[c] * a[m];
+    }
+}
+
+void Subspace::step(const float* q, const float* previous, glm::vec3 wind, float* next) {
+    advance(q, previous, wind, next);
+    for (unsigned int m = 0; m < modes; m++) {
+        next[m] = glm::clamp(next[m], lower[m], upper[m]);
+    }
+}
+
+void Subspace::reconstruct(const float* q, glm::vec3* positions) {
+    // one mode at a time, so the inner loop streams along the basis and vectorizes
+    float* __restrict out = (float*) positions;
+    memcpy(out, mean.data(), dimension * sizeof(float));
+    for (unsigned int m = 0; m < modes; m++) {
+        const float* __restrict mode = &basis[m * dimension];
+        float weight = q[m];
+        for (unsigned int d = 0; d < dimension; d++) {
+            out[d] += weight * mode[d];
+        }
+    }
+}
+
+void Subspace::computeNormals(const glm::vec3* positions, glm::vec3* normals) {
+    unsigned int count = dimension / 3;
+    fill(normals, normals + count, glm::vec3(0.0f));
+    for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+        unsigned int a = indices[t], b = indices[t + 1], c = indices[t + 2];
+        glm::vec3 n = glm::cross(positions[b] - positions[a], positions[c] - positions[a]);
+        float len = glm::length(n);
+        if (len == 0.0f) continue;
+        n /= len;
+        normals[a] += n;
+        normals[b] += n;
+        normals[c] += n;
+    }
+    for (unsigned int i = 0; i < count; i++) {
+        float len = glm::length(normals[i]);
+        if (len > 0.0f) normals[i] /= len;
+    }
+}
+
+void Subspace::startState(unsigned int pick, float* q, float* previous) {
+    unsigned int frames = (unsigned int) (trajectory.size() / modes);
+    unsigned int f = 1 + pick % (frames - 1);
+    copy_n(&trajectory[f * modes], modes, q);
+    copy_n(&trajectory[(f - 1) * modes], modes, previous);
+}
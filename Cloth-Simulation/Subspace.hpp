@@ -0,0 +1,99 @@
+//
+//  Subspace.hpp
+//
+
+#ifndef Subspace_hpp
+#define Subspace_hpp
+
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+
+#include "Cloth.hpp"
+
+#define SUBSPACE_MODES      24      // reduced coordinates a cloth is simulated in
+#define SUBSPACE_OVERSAMPLE 8       // extra directions of the randomized range finder
+#define SUBSPACE_POWER      2       // power iterations of the range finder, for modes with close variances
+#define SUBSPACE_RIDGE      1e-6    // first ridge of the dynamics fit, raised tenfold until a rollout stays bounded
+#define SUBSPACE_MARGIN     0.25f   // coordinates stay within their training range widened by this share
+#define GUST_FRAMES         90      // frames over which the wind drifts to its next gust
+
+using namespace std;
+
+// wind drifting from one random gust around a mean to the next every GUST_FRAMES frames
+class Gusts {
+private:
+    glm::vec3 mean, spread;
+    uint32_t state;
+    unsigned int frame;
+    glm::vec3 from, to;
+
+    // uniform in [-1, 1]
+    float random();
+
+public:
+    Gusts(glm::vec3 mean, glm::vec3 spread, uint32_t seed);
+
+    // wind over the coming frame
+    glm::vec3 next();
+};
+
+// Reduced-order model of a cloth, trained on a run of the full simulation.
+// The positions of every recorded frame, less their mean, are compressed by
+// PCA into SUBSPACE_MODES modes, found with a randomized range finder so only
+// a few passes over the snapshots are needed. The dynamics in those
+// coordinates is a linear map fitted by least squares over the training run:
+// the coordinates of the next frame from those of this frame and the last,
+// the wind and a constant (dynamic mode decomposition with control). A step
+// then costs a few hundred multiply-adds whatever the particle count, and the
+// positions are rebuilt from the modes only for drawing. The fit is
+// regularised until the model, run on its own over the training winds, stays
+// bounded; coordinates are also kept near the range seen in training. The
+// model only knows the motion it was trained on: the same pins, and winds
+// like the training gusts.
+class Subspace {
+private:
+    unsigned int dimension;     // 3 floats per particle
+    unsigned int modes;
+    vector<float> mean;         // x, y, z of every particle
+    vector<float> basis;        // mode k is [k * dimension, (k + 1) * dimension), orthonormal
+    vector<float> dynamics;     // 2 * modes + 4 rows of modes: weight of q(t), q(t - 1), wind and 1 in q(t + 1)
+    vector<float> lower, upper; // range of each coordinate
+    vector<float> trajectory;   // coordinates of every training frame, where instances start
+    vector<unsigned int> indices;
+    float captured;             // share of the training variance the modes hold
+
+    Subspace() {}
+
+    // step without keeping to the training range
+    void advance(const float* q, const float* previous, glm::vec3 wind, float* next);
+
+    // dynamics for one ridge; false if a rollout over the training winds leaves the training range far behind
+    bool fit(const vector<glm::vec3>& winds, double ridge);
+
+public:
+    // run the cloth for warmup frames, then record frames more, all under the gusts; the cloth is left moved
+    static Subspace* train(Cloth* cloth, Gusts& gusts, unsigned int warmup, unsigned int frames);
+
+    // coordinates of the next frame from those of this frame and the last under the wind of the coming frame
+    void step(const float* q, const float* previous, glm::vec3 wind, float* next);
+
+    // positions from the modes, mean plus basis times q
+    void reconstruct(const float* q, glm::vec3* positions);
+
+    // smooth shading normals of reconstructed positions
+    void computeNormals(const glm::vec3* positions, glm::vec3* normals);
+
+    // two consecutive training frames to start from, chosen by any number
+    void startState(unsigned int pick, float* q, float* previous);
+
+    unsigned int getModes() { return modes; }
+
+    unsigned int getParticleCount() { return dimension / 3; }
+
+    const vector<unsigned int>& getIndices() { return indices; }
+
+    float getCapturedVariance() { return captured; }
+};
+
+#endif /* Subspace_hpp */
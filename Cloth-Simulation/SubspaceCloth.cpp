@@ -0,0 +1,152 @@
+//
+//  SubspaceCloth.cpp
+//
+
+#include "SubspaceCloth.hpp"
+
+SubspaceCloth::SubspaceCloth(Subspace* subspace, glm::vec3 wind, glm::vec3 gustSpread, glm::vec3 color, glm::vec3 position, uint32_t seed)
+    : subspace(subspace), gusts(wind, gustSpread, seed) {
+    this->model = glm::translate(glm::mat4(1.0f), position);
+    this->color = color;
+
+    unsigned int modes = subspace->getModes();
+    q.resize(modes);
+    previous.resize(modes);
+    next.resize(modes);
+    subspace->startState(seed, q.data(), previous.data());
+
+    positions.resize(subspace->getParticleCount());
+    normals.resize(subspace->getParticleCount());
+    previousPositions.resize(subspace->getParticleCount());
+    previousNormals.resize(subspace->getParticleCount());
+    subspace->reconstruct(q.data(), positions.data());
+    subspace->computeNormals(positions.data(), normals.data());
+    subspace->reconstruct(previous.data(), previousPositions.data());
+    subspace->computeNormals(previousPositions.data(), previousNormals.data());
+    steps = 0;
+    blend = 1.0f;
+    previousKept = true;
+
+    initBuffers();
+}
+
+void SubspaceCloth::draw(const glm::mat4& viewProjMtx, GLuint shader) {
+    // rebuild the positions once per step, not once per frame drawn
+    if (steps > 0) {
+        // the state before is only needed when drawing between steps;
+        // after a single step it is the one drawn last
+        previousKept = blend < 1.0f;
+        if (previousKept && steps == 1) {
+            previousPositions.swap(positions);
+            previousNormals.swap(normals);
+        }
+        else if (previousKept) {
+            subspace->reconstruct(previous.data(), previousPositions.data());
+            subspace->computeNormals(previousPositions.data(), previousNormals.data());
+        }
+        subspace->reconstruct(q.data(), positions.data());
+        subspace->computeNormals(positions.data(), normals.data());
+
+        glBindBuffer(GL_ARRAY_BUFFER, VBO_positions);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(glm::vec3) * positions.size(), positions.data());
+        glBindBuffer(GL_ARRAY_BUFFER, VBO_normals);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(glm::vec3) * normals.size(), normals.data());
+        if (previousKept) {
+            glBindBuffer(GL_ARRAY_BUFFER, VBO_previousPositions);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(glm::vec3) * previousPositions.size(), previousPositions.data());
+            glBindBuffer(GL_ARRAY_BUFFER, VBO_previousNormals);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(glm::vec3) * previousNormals.size(), previousNormals.data());
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        steps = 0;
+    }
+
+    glUseProgram(shader);
+
+    // get the locations and send the uniforms to the shader
+    glUniformMatrix4fv(glGetUniformLocation(shader, "viewProj"), 1, GL_FALSE, (float*)&viewProjMtx);
+    glUniformMatrix4fv(glGetUniformLocation(shader, "model"), 1, GL_FALSE, (float*)&model);
+    glUniform3fv(glGetUniformLocation(shader, "DiffuseColor"), 1, &color[0]);
+    glUniform1f(glGetUniformLocation(shader, "blend"), previousKept ? blend : 1.0f);
+
+    // Bind the VAO
+    glBindVertexArray(VAO);
+
+    // draw the points using triangles, indexed with the EBO
+    glDrawElements(GL_TRIANGLES, (unsigned int) subspace->getIndices().size(), GL_UNSIGNED_INT, 0);
+
+    // Unbind the VAO and shader program, other objects are drawn without blending
+    glBindVertexArray(0);
+    glUniform1f(glGetUniformLocation(shader, "blend"), 1.0f);
+    glUseProgram(0);
+}
+
+void SubspaceCloth::update() {
+    subspace->step(q.data(), previous.data(), gusts.next(), next.data());
+    previous.swap(q);
+    q.swap(next);
+    steps++;
+}
+
+void SubspaceCloth::setBlend(float alpha) {
+    blend = alpha;
+}
+
+void SubspaceCloth::translate(glm::vec3 offset) {
+    model = glm::translate(model, offset);
+}
+
+void SubspaceCloth::initBuffers() {
+    const vector<unsigned int>& indices = subspace->getIndices();
+
+    // generate a vertex array (VAO) and two vertex buffer objects (VBO).
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO_positions);
+    glGenBuffers(1, &VBO_normals);
+    glGenBuffers(1, &VBO_previousPositions);
+    glGenBuffers(1, &VBO_previousNormals);
+    glGenBuffers(1, &EBO);
+
+    // bind to the VAO.
+    glBindVertexArray(VAO);
+
+    // bind to the first VBO - We will use it to store the vertices
+    glBindBuffer(GL_ARRAY_BUFFER, VBO_positions);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * positions.size(), positions.data(), GL_DYNAMIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), 0);
+
+    // bind to the second VBO - We will use it to store the normals
+    glBindBuffer(GL_ARRAY_BUFFER, VBO_normals);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * normals.size(), normals.data(), GL_DYNAMIC_DRAW);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), 0);
+
+    // the state of the step before, drawn towards the current one by the blend
+    glBindBuffer(GL_ARRAY_BUFFER, VBO_previousPositions);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * previousPositions.size(), previousPositions.data(), GL_DYNAMIC_DRAW);
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), 0);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO_previousNormals);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * previousNormals.size(), previousNormals.data(), GL_DYNAMIC_DRAW);
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), 0);
+
+    // bind the EBO to the bound VAO and send the data
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * indices.size(), indices.data(), GL_STATIC_DRAW);
+
+    // unbind the VBOs.
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
+SubspaceCloth::~SubspaceCloth() {
+    // Delete the VBOs and the VAO.
+    glDeleteBuffers(1, &VBO_positions);
+    glDeleteBuffers(1, &VBO_normals);
+    glDeleteBuffers(1, &VBO_previousPositions);
+    glDeleteBuffers(1, &VBO_previousNormals);
+    glDeleteBuffers(1, &EBO);
+    glDeleteVertexArrays(1, &VAO);
+}
@@ -0,0 +1,54 @@
+//
+//  SubspaceCloth.hpp
+//
+
+#ifndef SubspaceCloth_hpp
+#define SubspaceCloth_hpp
+
+#include <stdio.h>
+#include "Object.hpp"
+#include "Subspace.hpp"
+
+using namespace std;
+
+// Background cloth stepped in the reduced coordinates of a shared subspace
+// under its own gusts. Positions and normals are rebuilt only when the cloth
+// is drawn after a step, so one that is not drawn costs a step alone; those of
+// the step before are kept beside them for drawing in between.
+class SubspaceCloth : public Object {
+private:
+    GLuint VAO;
+    GLuint VBO_positions, VBO_normals, EBO;
+    GLuint VBO_previousPositions, VBO_previousNormals;
+
+    Subspace* subspace; // shared, not owned
+    Gusts gusts;
+    vector<float> q, previous, next;
+
+    vector<glm::vec3> positions;
+    vector<glm::vec3> normals;
+    vector<glm::vec3> previousPositions;
+    vector<glm::vec3> previousNormals;
+    unsigned int steps; // taken since the buffers were filled
+    float blend;
+    bool previousKept;  // the previous buffers hold the step before the current one
+
+    void initBuffers();
+
+public:
+
+    // starts from a training frame picked by the seed, which also seeds the gusts
+    SubspaceCloth(Subspace* subspace, glm::vec3 wind, glm::vec3 gustSpread, glm::vec3 color, glm::vec3 position, uint32_t seed);
+
+    void draw(const glm::mat4& viewProjMtx, GLuint shader);
+
+    void setBlend(float alpha);
+
+    void update();
+
+    void translate(glm::vec3 offset);
+
+    ~SubspaceCloth();
+
+};
+#endif /* SubspaceCloth_hpp */
@@ -0,0 +1,297 @@
+//
+//  Terrain.cpp
+//
+
+#include "Terrain.hpp"
+
+#include <math.h>
+#include <fstream>
+#include <iostream>
+
+Terrain::Terrain(float halfSize, float height, unsigned int res, glm::vec3 color)
+    : Terrain(res, res, vector<float>(res * res, height), halfSize, color) {}
+
+Terrain::Terrain(unsigned int resX, unsigned int resZ, const vector<float>& heights,
+                 float halfSize, glm::vec3 color) {
+    model = glm::mat4(1.0f);
+    this->color = color;
+    this->resX = resX < 2 ? 2 : resX;
+    this->resZ = resZ < 2 ? 2 : resZ;
+    this->halfSize = halfSize;
+    this->cellX = 2.0f * halfSize / (this->resX - 1);
+    this->cellZ = 2.0f * halfSize / (this->resZ - 1);
+    this->heights = heights;
+    this->heights.resize(this->resX * this->resZ, heights.empty() ? 0.0f : heights.back());
+
+    initMesh();
+    initBuffers();
+}
+
+Terrain* Terrain::load(const char* path, float halfSize, float baseHeight,
+                       float heightScale, glm::vec3 color) {
+    ifstream file(path, ios::binary);
+    if (!file) {
+        cerr << "Failed to open terrain file " << path << endl;
+        return NULL;
+    }
+
+    unsigned int w = 0, h = 0, maxVal = 65535;
+    bool bigEndian = false;
+
+    char magic[2] = {0, 0};
+    file.read(magic, 2);
+    if (magic[0] == 'P' && magic[1] == '5') {
+        // binary PGM: header tokens may be separated by comments
+        unsigned int header[3];
+        for (unsigned int i = 0; i < 3; i++) {
+            file >> ws;
+            while (file.peek() == '#') {
+                file.ignore(1 << 16, '\n');
+                file >> ws;
+            }
+            file >> header[i];
+        }
+        file.get(); // single whitespace before the raster
+        w = header[0];
+        h = header[1];
+        maxVal = header[2];
+        bigEndian = true; // PGM stores 16-bit samples most significant byte first
+    }
+    else {
+        // raw: square grid of little-endian 16-bit samples
+        file.seekg(0, ios::end);
+        size_t count = (size_t) file.tellg() / 2;
+        file.seekg(0, ios::beg);
+        w = h = (unsigned int) sqrt((double) count);
+        if ((size_t) w * h != count) {
+            cerr << "Raw terrain " << path << " is not a square 16-bit grid" << endl;
+            return NULL;
+        }
+    }
+
+    if (w < 2 || h < 2 || maxVal == 0 || maxVal > 65535) {
+        cerr << "Unsupported terrain file " << path << endl;
+        return NULL;
+    }
+
+    unsigned int bytesPerSample = maxVal > 255 ? 2 : 1;
+    vector<unsigned char> raster((size_t) w * h * bytesPerSample);
+    file.read((char*) raster.data(), raster.size());
+    if ((size_t) file.gcount() != raster.size()) {
+        cerr << "Terrain file " << path << " is truncated" << endl;
+        return NULL;
+    }
+
+    vector<float> heights((size_t) w * h);
+    float scale = heightScale / maxVal;
+    for (size_t i = 0; i < heights.size(); i++) {
+        unsigned int sample;
+        if (bytesPerSample == 1) {
+            sample = raster[i];
+        }
+        else if (bigEndian) {
+            sample = (raster[2 * i] << 8) | raster[2 * i + 1];
+        }
+        else {
+            sample = raster[2 * i] | (raster[2 * i + 1] << 8);
+        }
+        heights[i] = baseHeight + scale * sample;
+    }
+
+    return new Terrain(w, h, heights, halfSize, color);
+}
+
+float Terrain::getHeight(float x, float z) {
+    // continuous sample coordinates, clamped so the border extends outward
+    float u = glm::clamp((x + halfSize) / cellX, 0.0f, (float) (resX - 1));
+    float v = glm::clamp((z + halfSize) / cellZ, 0.0f, (float) (resZ - 1));
+    unsigned int i = glm::min((unsigned int) u, resX - 2);
+    unsigned int j = glm::min((unsigned int) v, resZ - 2);
+    float fu = u - i;
+    float fv = v - j;
+
+    const float* row0 = &heights[j * resX + i];
+    const float* row1 = row0 + resX;
+    float h0 = row0[0] + fu * (row0[1] - row0[0]);
+    float h1 = row1[0] + fu * (row1[1] - row1[0]);
+    return h0 + fv * (h1 - h0);
+}
+
+glm::vec3 Terrain::getNormal(float x, float z) {
+    float u = glm::clamp((x + halfSize) / cellX, 0.0f, (float) (resX - 1));
+    float v = glm::clamp((z + halfSize) / cellZ, 0.0f, (float) (resZ - 1));
+    unsigned int i = glm::min((unsigned int) u, resX - 2);
+    unsigned int j = glm::min((unsigned int) v, resZ - 2);
+    float fu = u - i;
+    float fv = v - j;
+
+    // gradient of the bilinear patch
+    const float* row0 = &heights[j * resX + i];
+    const float* row1 = row0 + resX;
+    float dhdx = ((row0[1] - row0[0]) * (1.0f - fv) + (row1[1] - row1[0]) * fv) / cellX;
+    float dhdz = ((row1[0] - row0[0]) * (1.0f - fu) + (row1[1] - row0[1]) * fu) / cellZ;
+    return glm::normalize(glm::vec3(-dhdx, 1.0f, -dhdz));
+}
+
+void Terrain::lookupHeights(const float* px, const float* pz, unsigned int count, float skin, float* ground) {
+    float maxU = (float) (resX - 1), maxV = (float) (resZ - 1);
+    float invCellX = 1.0f / cellX, invCellZ = 1.0f / cellZ;
+    for (unsigned int k = 0; k < count; k++) {
+        float u = glm::clamp((px[k] + halfSize) * invCellX, 0.0f, maxU);
+        float v = glm::clamp((pz[k] + halfSize) * invCellZ, 0.0f, maxV);
+        unsigned int i = glm::min((unsigned int) u, resX - 2);
+        unsigned int j = glm::min((unsigned int) v, resZ - 2);
+        float fu = u - i;
+        float fv = v - j;
+        unsigned int id = j * resX + i;
+        float h0 = heights[id] + fu * (heights[id + 1] - heights[id]);
+        float h1 = heights[id + resX] + fu * (heights[id + resX + 1] - heights[id + resX]);
+        ground[k] = h0 + fv * (h1 - h0) + skin;
+    }
+}
+
+glm::vec3 Terrain::resolveVelocity(glm::vec3 v, float x, float z, float elasticity, float friction) {
+    // bounce the normal component of the velocity, damp the tangential one
+    glm::vec3 n = getNormal(x, z);
+    glm::vec3 vn = glm::dot(v, n) * n;
+    glm::vec3 vt = v - vn;
+    if (glm::dot(vn, n) < 0.0f) {
+        vn = -elasticity * vn;
+    }
+    return vn + (1.0f - friction) * vt;
+}
+
+void Terrain::handleCollision(vector<Particle*>& particles, float elasticity, float friction, float skin) {
+    float ground[TERRAIN_BATCH];
+    float px[TERRAIN_BATCH], pz[TERRAIN_BATCH];
+
+    for (size_t start = 0; start < particles.size(); start += TERRAIN_BATCH) {
+        unsigned int count = (unsigned int) glm::min(particles.size() - start, (size_t) TERRAIN_BATCH);
+
+        // gather the batch, then look up all heights in a branch-free loop
+        for (unsigned int k = 0; k < count; k++) {
+            px[k] = particles[start + k]->p.x;
+            pz[k] = particles[start + k]->p.z;
+        }
+        lookupHeights(px, pz, count, skin, ground);
+
+        // resolve the (usually few) particles below the surface
+        for (unsigned int k = 0; k < count; k++) {
+            Particle* particle = particles[start + k];
+            if (particle->p.y >= ground[k]) continue;
+
+            particle->p.y = 2.0f * ground[k] - particle->p.y;
+            particle->v = resolveVelocity(particle->v, px[k], pz[k], elasticity, friction);
+        }
+    }
+}
+
+void Terrain::handleCollision(float* x, float* y, float* z, float* vx, float* vy, float* vz,
+                              unsigned int count, float elasticity, float friction, float skin) {
+    float ground[TERRAIN_BATCH];
+
+    // positions are already in arrays, so batches are looked up in place
+    for (unsigned int start = 0; start < count; start += TERRAIN_BATCH) {
+        unsigned int batch = glm::min(count - start, (unsigned int) TERRAIN_BATCH);
+        lookupHeights(x + start, z + start, batch, skin, ground);
+
+        for (unsigned int k = 0; k < batch; k++) {
+            unsigned int i = start + k;
+            if (y[i] >= ground[k]) continue;
+
+            y[i] = 2.0f * ground[k] - y[i];
+            glm::vec3 v = resolveVelocity(glm::vec3(vx[i], vy[i], vz[i]), x[i], z[i], elasticity, friction);
+            vx[i] = v.x;
+            vy[i] = v.y;
+            vz[i] = v.z;
+        }
+    }
+}
+
+void Terrain::initMesh() {
+    positions.resize(resX * resZ);
+    normals.resize(resX * resZ);
+    for (unsigned int j = 0; j < resZ; j++) {
+        for (unsigned int i = 0; i < resX; i++) {
+            float x = -halfSize + i * cellX;
+            float z = -halfSize + j * cellZ;
+            positions[j * resX + i] = glm::vec3(x, heights[j * resX + i], z);
+            normals[j * resX + i] = getNormal(x, z);
+        }
+    }
+
+    indices.reserve((resX - 1) * (resZ - 1) * 6);
+    for (unsigned int j = 0; j < resZ - 1; j++) {
+        for (unsigned int i = 0; i < resX - 1; i++) {
+            unsigned int currId = j * resX + i;
+            unsigned int rightId = currId + 1;
+            unsigned int downId = currId + resX;
+            unsigned int downRightId = downId + 1;
+            // counter-clockwise seen from above (+y)
+            indices.insert(indices.end(), {currId, downId, downRightId});
+            indices.insert(indices.end(), {currId, downRightId, rightId});
+        }
+    }
+}
+
+void Terrain::initBuffers() {
+    // generate a vertex array (VAO) and two vertex buffer objects (VBO).
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO_positions);
+    glGenBuffers(1, &VBO_normals);
+    glGenBuffers(1, &EBO);
+
+    // bind to the VAO.
+    glBindVertexArray(VAO);
+
+    // bind to the first VBO - We will use it to store the vertices
+    glBindBuffer(GL_ARRAY_BUFFER, VBO_positions);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * positions.size(), positions.data(), GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), 0);
+
+    // bind to the second VBO - We will use it to store the normals
+    glBindBuffer(GL_ARRAY_BUFFER, VBO_normals);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * normals.size(), normals.data(), GL_STATIC_DRAW);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), 0);
+
+    // bind the EBO to the bound VAO and send the data
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * indices.size(), indices.data(), GL_STATIC_DRAW);
+
+    // unbind the VBOs.
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
+void Terrain::draw(const glm::mat4& viewProjMtx, GLuint shader) {
+    glUseProgram(shader);
+
+    // get the locations and send the uniforms to the shader
+    glUniformMatrix4fv(glGetUniformLocation(shader, "viewProj"), 1, GL_FALSE, (float*)&viewProjMtx);
+    glUniformMatrix4fv(glGetUniformLocation(shader, "model"), 1, GL_FALSE, (float*)&model);
+    glUniform3fv(glGetUniformLocation(shader, "DiffuseColor"), 1, &color[0]);
+
+    // Bind the VAO
+    glBindVertexArray(VAO);
+
+    // draw the points using triangles, indexed with the EBO
+    glDrawElements(GL_TRIANGLES, (unsigned int) indices.size(), GL_UNSIGNED_INT, 0);
+
+    // Unbind the VAO and shader program
+    glBindVertexArray(0);
+    glUseProgram(0);
+}
+
+void Terrain::update() {}
+
+void Terrain::translate(glm::vec3 offset) {}
+
+Terrain::~Terrain() {
+    // Delete the VBOs and the VAO.
+    glDeleteBuffers(1, &VBO_positions);
+    glDeleteBuffers(1, &VBO_normals);
+    glDeleteBuffers(1, &EBO);
+    glDeleteVertexArrays(1, &VAO);
+}
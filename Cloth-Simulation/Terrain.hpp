@@ -0,0 +1,72 @@
+//
+//  Terrain.hpp
+//
+
+#ifndef Terrain_hpp
+#define Terrain_hpp
+
+#include <stdio.h>
+#include "Object.hpp"
+#include "Particle.hpp"
+
+#define TERRAIN_BATCH   16  // number of particles resolved per collision batch
+
+using namespace std;
+
+class Terrain : public Object {
+private:
+    // buffers for rendering
+    GLuint VAO;
+    GLuint VBO_positions, VBO_normals, EBO;
+
+    vector<glm::vec3> positions;
+    vector<glm::vec3> normals;
+    vector<unsigned int> indices;
+
+    unsigned int resX;      // number of height samples on x axis
+    unsigned int resZ;      // number of height samples on z axis
+    float halfSize;         // half of the extent of the terrain on x and z axis
+    float cellX;            // distance between two samples on x axis
+    float cellZ;            // distance between two samples on z axis
+    vector<float> heights;  // row-major height samples, row 0 at -halfSize on z
+
+    void initMesh();
+
+    void initBuffers();
+
+    // ground height plus skin below each of count points
+    void lookupHeights(const float* px, const float* pz, unsigned int count, float skin, float* ground);
+
+    glm::vec3 resolveVelocity(glm::vec3 v, float x, float z, float elasticity, float friction);
+
+public:
+
+    Terrain(float halfSize, float height, unsigned int res, glm::vec3 color);
+
+    Terrain(unsigned int resX, unsigned int resZ, const vector<float>& heights,
+            float halfSize, glm::vec3 color);
+
+    // load a 16-bit heightfield from a binary PGM (P5) or a square raw file, NULL on failure
+    static Terrain* load(const char* path, float halfSize, float baseHeight,
+                         float heightScale, glm::vec3 color);
+
+    float getHeight(float x, float z);
+
+    glm::vec3 getNormal(float x, float z);
+
+    void handleCollision(vector<Particle*>& particles, float elasticity, float friction, float skin);
+
+    // the same for count points stored as one array per component
+    void handleCollision(float* x, float* y, float* z, float* vx, float* vy, float* vz,
+                         unsigned int count, float elasticity, float friction, float skin);
+
+    void draw(const glm::mat4& viewProjMtx, GLuint shader);
+
+    void update();
+
+    void translate(glm::vec3 offset);
+
+    ~Terrain();
+};
+
+#endif /* Terrain_hpp */
@@ -0,0 +1,113 @@
+//
+//  Tracer.cpp
+//
+
+#include "Tracer.hpp"
+
+#include <chrono>
+#include <iostream>
+
+std::mutex Tracer::registryLock;
+std::vector<std::unique_ptr<TraceBuffer>> Tracer::buffers;
+std::vector<TraceBuffer*> Tracer::freeBuffers;
+
+static thread_local TraceBuffer* threadBuffer = NULL;
+
+// releases the ring of its thread on thread exit, so short-lived threads such as scene builds share rings
+struct ThreadRing {
+    ~ThreadRing() { Tracer::releaseBuffer(); }
+};
+static thread_local ThreadRing threadRing;
+static const std::chrono::steady_clock::time_point traceStart = std::chrono::steady_clock::now();
+
+bool Tracer::isEnabled() {
+#ifdef ENABLE_TRACING
+    return true;
+#else
+    return false;
+#endif
+}
+
+uint64_t Tracer::now() {
+    auto elapsed = std::chrono::steady_clock::now() - traceStart;
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+}
+
+TraceBuffer* Tracer::getBuffer() {
+    if (!threadBuffer) {
+        (void) &threadRing; // constructs it for this thread, so the ring is released when the thread exits
+        std::lock_guard<std::mutex> guard(registryLock);
+        if (!freeBuffers.empty()) { // the timeline shows the new thread on the lane of the old one
+            threadBuffer = freeBuffers.back();
+            freeBuffers.pop_back();
+            return threadBuffer;
+        }
+        buffers.emplace_back(new TraceBuffer((unsigned int) buffers.size() + 1));
+        threadBuffer = buffers.back().get();
+    }
+    return threadBuffer;
+}
+
+void Tracer::releaseBuffer() {
+    if (!threadBuffer) return;
+    std::lock_guard<std::mutex> guard(registryLock);
+    freeBuffers.push_back(threadBuffer);
+    threadBuffer = NULL;
+}
+
+void Tracer::record(const char* name, char phase) {
+    TraceBuffer* buffer = getBuffer();
+    uint64_t head = buffer->head.load(std::memory_order_relaxed);
+    TraceEvent& event = buffer->events[head % TRACER_CAPACITY];
+    event.name = name;
+    event.time = now();
+    event.phase = phase;
+    buffer->head.store(head + 1, std::memory_order_release);
+}
+
+void Tracer::setThreadName(const char* name) {
+    // without tracing no thread ever records, so it needs no ring
+    if (!isEnabled()) return;
+    getBuffer()->name = name;
+}
+
+bool Tracer::write(const char* path) {
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        std::cerr << "Failed to write trace " << path << std::endl;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> guard(registryLock);
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    std::vector<TraceEvent> events;
+    for (const std::unique_ptr<TraceBuffer>& buffer : buffers) {
+        if (buffer->name) {
+            fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                    first ? "" : ",\n", buffer->tid, buffer->name);
+            first = false;
+        }
+
+        // copy the live part of the ring, then drop whatever the owner overwrote meanwhile
+        uint64_t head = buffer->head.load(std::memory_order_acquire);
+        uint64_t begin = head > TRACER_CAPACITY ? head - TRACER_CAPACITY : 0;
+        events.clear();
+        for (uint64_t i = begin; i < head; i++) {
+            events.push_back(buffer->events[i % TRACER_CAPACITY]);
+        }
+        uint64_t after = buffer->head.load(std::memory_order_acquire);
+        uint64_t valid = after + 1 > TRACER_CAPACITY ? after + 1 - TRACER_CAPACITY : 0;
+
+        for (uint64_t i = begin; i < head; i++) {
+            if (i < valid) continue;
+            const TraceEvent& event = events[i - begin];
+            fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%u}",
+                    first ? "" : ",\n", event.name, event.phase, event.time / 1000.0, buffer->tid);
+            first = false;
+        }
+    }
+    fprintf(file, "\n]}\n");
+    fclose(file);
+    return true;
+}
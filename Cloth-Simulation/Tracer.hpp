@@ -0,0 +1,81 @@
+//
+//  Tracer.hpp
+//
+
+#ifndef Tracer_hpp
+#define Tracer_hpp
+
+#include <stdio.h>
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#define TRACER_CAPACITY     (1 << 16)   // events kept per thread, older ones are overwritten
+
+// Begin/end events compile to nothing unless ENABLE_TRACING is defined.
+#ifdef ENABLE_TRACING
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+#else
+#define TRACE_SCOPE(name)
+#endif
+
+struct TraceEvent {
+    const char* name;   // must outlive the tracer, i.e. a string literal
+    uint64_t time;      // nanoseconds since the tracer started
+    char phase;         // 'B' or 'E'
+};
+
+// Each thread writes into its own ring without locking; the ring is only
+// published through its atomic head, so a dump can run while threads trace.
+class TraceBuffer {
+public:
+    std::vector<TraceEvent> events;
+    std::atomic<uint64_t> head;     // number of events ever written
+    unsigned int tid;
+    const char* name;
+
+    TraceBuffer(unsigned int tid) : events(TRACER_CAPACITY), head(0), tid(tid), name(NULL) {}
+};
+
+class Tracer {
+private:
+    friend struct ThreadRing;
+
+    static std::mutex registryLock;     // only taken when a thread traces for the first time or exits
+    static std::vector<std::unique_ptr<TraceBuffer>> buffers;
+    static std::vector<TraceBuffer*> freeBuffers;   // rings of exited threads, taken over by the next thread that traces
+
+    static TraceBuffer* getBuffer();
+
+    // hand the ring of the calling thread on when it exits; its events stay for the dump
+    static void releaseBuffer();
+
+public:
+    static bool isEnabled();
+
+    static uint64_t now();
+
+    static void record(const char* name, char phase);
+
+    // label the calling thread in the timeline, nothing unless tracing is compiled in
+    static void setThreadName(const char* name);
+
+    // write every buffered event as Chrome trace JSON, loadable in chrome://tracing or Perfetto
+    static bool write(const char* path);
+};
+
+class TraceScope {
+private:
+    const char* name;
+
+public:
+    TraceScope(const char* name) : name(name) { Tracer::record(name, 'B'); }
+
+    ~TraceScope() { Tracer::record(name, 'E'); }
+};
+
+#endif /* Tracer_hpp */
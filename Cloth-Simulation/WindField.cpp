@@ -0,0 +1,126 @@
+//
+//  WindField.cpp
+//
+
+#include "WindField.hpp"
+
+#include <math.h>
+#include <stdint.h>
+
+// octaves of the volume: size relative to the first, share of the eddies, speed
+// relative to the mean wind, and a shift in grid points so the octaves do not
+// line up where the volume repeats; the octaves slide past each other, so the
+// sum never repeats as a whole
+static const float layerScale[WIND_LAYERS] = {1.0f, 2.7f};
+static const float layerWeight[WIND_LAYERS] = {0.85f, 0.5f};
+static const float layerDrift[WIND_LAYERS] = {1.0f, 0.8f};
+static const float layerShift[WIND_LAYERS] = {0.0f, 11.3f};
+
+WindField::WindField(unsigned int seed) {
+    bake(seed);
+}
+
+void WindField::bake(unsigned int seed) {
+    // the same numbers on every platform, so scenes with turbulence replay the same way
+    uint32_t state = seed;
+    auto next = [&state]() {
+        state = state * 1664525u + 1013904223u;
+        return (float) (state >> 8) / 16777216.0f;
+    };
+
+    // the curl of a periodic vector potential a sin(k.x + phase) is the wave (k x a) cos(k.x + phase),
+    // divergence free and tileable for whole wave numbers; longer waves carry more energy
+    const float twoPi = 6.2831853f;
+    glm::vec3 k[WIND_MODES], a[WIND_MODES];
+    float phase[WIND_MODES];
+    for (unsigned int m = 0; m < WIND_MODES; m++) {
+        do {
+            k[m] = glm::floor(glm::vec3(next(), next(), next()) * 7.0f) - 3.0f;
+        } while (k[m] == glm::vec3(0.0f));
+        glm::vec3 potential = glm::vec3(next(), next(), next()) * 2.0f - 1.0f;
+        a[m] = glm::cross(k[m], potential) / glm::dot(k[m], k[m]);
+        k[m] *= twoPi / WIND_GRID;
+        phase[m] = twoPi * next();
+    }
+
+    // four floats per grid point, so a corner of a cell is one aligned vector load
+    const unsigned int n = WIND_GRID * WIND_GRID * WIND_GRID;
+    cells.assign(4 * n, 0.0f);
+    double sum2 = 0.0;
+    for (unsigned int i = 0; i < n; i++) {
+        glm::vec3 x((float) (i % WIND_GRID), (float) (i / WIND_GRID % WIND_GRID), (float) (i / (WIND_GRID * WIND_GRID)));
+        glm::vec3 v(0.0f);
+        for (unsigned int m = 0; m < WIND_MODES; m++) {
+            v += a[m] * cos(glm::dot(k[m], x) + phase[m]);
+        }
+        cells[4 * i] = v.x;
+        cells[4 * i + 1] = v.y;
+        cells[4 * i + 2] = v.z;
+        sum2 += glm::dot(v, v);
+    }
+
+    float scale = sum2 > 0.0 ? (float) (1.0 / sqrt(sum2 / n)) : 0.0f;
+    for (float& c : cells) {
+        c *= scale;
+    }
+}
+
+float WindField::gust(float time) {
+    // two slow waves with no common period
+    return 1.0f + WIND_GUST * (0.6f * sin(0.71f * time) + 0.4f * sin(1.93f * time + 1.3f));
+}
+
+void WindField::sample(const float* x, const float* y, const float* z, size_t n,
+                       glm::vec3 mean, float time, float* wx, float* wy, float* wz) const {
+    glm::vec3 base = mean * gust(time);
+    for (size_t i = 0; i < n; i++) {
+        wx[i] = base.x;
+        wy[i] = base.y;
+        wz[i] = base.z;
+    }
+    float speed = glm::length(mean);
+    if (speed == 0.0f) return;
+
+    const float* __restrict g = cells.data();
+    const int mask = WIND_GRID - 1;
+    for (unsigned int l = 0; l < WIND_LAYERS; l++) {
+        float scale = layerScale[l] * WIND_GRID / WIND_PERIOD; // grid points per meter
+        float weight = layerWeight[l] * WIND_TURBULENCE * speed;
+        
+        // the eddies drift with the mean wind; wrapped so the lookups keep their precision over time
+        glm::vec3 shift = glm::mod(glm::vec3(layerShift[l]) - layerDrift[l] * mean * time * scale, (float) WIND_GRID);
+        
+        // trilinear blend of the eight grid points around each sample, without branches
+        for (size_t i = 0; i < n; i++) {
+            float u = x[i] * scale + shift.x;
+            float v = y[i] * scale + shift.y;
+            float w = z[i] * scale + shift.z;
+            // floor as a truncation stepped down for negative coordinates
+            int iu = (int) u, iv = (int) v, iw = (int) w;
+            iu -= u < iu;
+            iv -= v < iv;
+            iw -= w < iw;
+            float tu = u - iu, tv = v - iv, tw = w - iw;
+            const float* row00 = g + 4 * ((iw & mask) * WIND_GRID + (iv & mask)) * WIND_GRID;
+            const float* row01 = g + 4 * ((iw & mask) * WIND_GRID + ((iv + 1) & mask)) * WIND_GRID;
+            const float* row10 = g + 4 * (((iw + 1) & mask) * WIND_GRID + (iv & mask)) * WIND_GRID;
+            const float* row11 = g + 4 * (((iw + 1) & mask) * WIND_GRID + ((iv + 1) & mask)) * WIND_GRID;
+            int u0 = 4 * (iu & mask), u1 = 4 * ((iu + 1) & mask);
+            
+            // along u, then v, then w, all four lanes of a grid point at once
+            float sum[4];
+            for (unsigned int lane = 0; lane < 4; lane++) {
+                float a00 = row00[u0 + lane] + tu * (row00[u1 + lane] - row00[u0 + lane]);
+                float a01 = row01[u0 + lane] + tu * (row01[u1 + lane] - row01[u0 + lane]);
+                float a10 = row10[u0 + lane] + tu * (row10[u1 + lane] - row10[u0 + lane]);
+                float a11 = row11[u0 + lane] + tu * (row11[u1 + lane] - row11[u0 + lane]);
+                float b0 = a00 + tv * (a01 - a00);
+                float b1 = a10 + tv * (a11 - a10);
+                sum[lane] = b0 + tw * (b1 - b0);
+            }
+            wx[i] += weight * sum[0];
+            wy[i] += weight * sum[1];
+            wz[i] += weight * sum[2];
+        }
+    }
+}
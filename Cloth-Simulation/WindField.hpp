@@ -0,0 +1,43 @@
+//
+//  WindField.hpp
+//
+
+#ifndef WindField_hpp
+#define WindField_hpp
+
+#include <stdio.h>
+#include <vector>
+
+#include "Core.h"
+
+#define WIND_GRID       32      // grid points per side of the baked volume, a power of two
+#define WIND_PERIOD     4.0f    // size of the volume in the world before it repeats (m)
+#define WIND_MODES      32      // waves summed into the volume when baking
+#define WIND_LAYERS     2       // octaves of the volume added per sample
+#define WIND_TURBULENCE 0.35f   // rms of the eddies as a fraction of the mean wind speed
+#define WIND_GUST       0.3f    // largest change of the mean wind by a gust, as a fraction of it
+
+using namespace std;
+
+// Turbulent wind around a mean wind. A divergence free curl-noise volume is
+// baked once into a tileable grid. A sample adds a few octaves of it, carried
+// along by the mean wind, to the mean wind scaled by a slow gust envelope, so
+// it costs a few trilinear reads instead of a noise evaluation.
+class WindField {
+private:
+    vector<float> cells;    // eddy velocity at the grid points as x, y, z and a pad, rms 1
+
+    void bake(unsigned int seed);
+
+public:
+    WindField(unsigned int seed = 1);
+
+    // factor the mean wind is scaled by at a time
+    static float gust(float time);
+
+    // wind at n points given as one array per component, written the same way
+    void sample(const float* x, const float* y, const float* z, size_t n,
+                glm::vec3 mean, float time, float* wx, float* wy, float* wz) const;
+};
+
+#endif /* WindField_hpp */
@@ -8,6 +8,39 @@ const char* Window::windowTitle = "Cloth Simulation";
 // Objects to render
 vector<Object*> Window::objects;
 Cloth* Window::cloth;
+Terrain* Window::terrain;
+const char* Window::terrainFile = NULL;
+const char* Window::checkpointFile = "cloth.ckpt";
+bool Window::resumeCheckpoint = false;
+const char* Window::cacheFile = "cloth.cache";
+bool Window::recordAtStart = false;
+Recorder* Window::recorder = NULL;
+int Window::scene = 0;
+const char* Window::playFile = NULL;
+Player* Window::player = NULL;
+unsigned int Window::playFrame = 0;
+bool Window::playPaused = false;
+unsigned int Window::headlessFrames = 0;
+const char* Window::outputPrefix = "frame";
+const char* Window::goldenDir = NULL;
+bool Window::goldenRecord = false;
+unsigned int Window::goldenSteps = 600;
+float Window::goldenTolerance = 1e-4f;
+bool Window::springObjects = false;
+bool Window::tiledUpdate = false;
+bool Window::sleepTiles = false;
+bool Window::multirateTiles = false;
+float Window::strainLimit = 0.0f;
+WindField* Window::windField = NULL;
+bool Window::turbulentWind = false;
+bool Window::projectiveSolve = false;
+bool Window::remeshing = false;
+float Window::physicsRate = 0.0f;
+ReorderMethod Window::reorderMethod = REORDER_NONE;
+const char* Window::objFile = NULL;
+ClothCache Window::clothCache;
+SceneLoader Window::sceneLoader;
+Subspace* Window::bannerSubspace = NULL;
 
 // Camera Properties
 Camera* cam;
@@ -19,8 +52,28 @@ int mouseX, mouseY;
 
 glm::vec3 moveSpeed(0.0f);
 
+// Playback and recording frame buffers
+vector<glm::vec3> playPositions;
+vector<glm::vec3> recordPositions;
+
+// Cloth built by the loader, sent to the GPU a slice per frame before it is swapped in
+Cloth* incoming = NULL;
+int incomingScene = 0;
+int wantedScene = 0; // last scene asked for, differs from the scene while a build is in flight
+
+// Fixed-rate stepping
+double lastIdleTime = -1.0; // wall time of the last idle call, none before the first
+double stepLag = 0.0;       // time since the last step, less than a step
+
 // The shader program id
 GLuint Window::shaderProgram;
+GLuint Window::hudProgram;
+
+// Profiler overlay
+Hud* Window::hud = NULL;
+bool Window::showHud = false;
+const char* Window::profileFile = NULL;
+const char* Window::traceFile = "trace.json";
 
 // Constructors and desctructors 
 bool Window::initializeProgram() {
@@ -35,6 +88,20 @@ bool Window::initializeProgram() {
 		return false;
 	}
 
+	// The overlay is optional, only profiled builds have something to show.
+	if (Profiler::isEnabled())
+	{
+		hudProgram = LoadShaders("hud.vert", "hud.frag");
+		if (hudProgram)
+		{
+			hud = new Hud(hudProgram);
+		}
+		if (profileFile && !Profiler::openCSV(profileFile))
+		{
+			std::cerr << "Failed to open profile file " << profileFile << std::endl;
+		}
+	}
+
 	return true;
 }
 
@@ -44,28 +111,56 @@ bool Window::initializeObjects()
     groundHeight = -3.0f;
     float halfGroundSize = 10.0f;
     
-    glm::vec3 planeColor = glm::vec3(0.1f, 0.1f, 0.1f);
-    glm::vec3 p1 = glm::vec3(-halfGroundSize, groundHeight, halfGroundSize);
-    glm::vec3 p2 = glm::vec3(halfGroundSize, groundHeight, halfGroundSize);
-    glm::vec3 p3 = glm::vec3(halfGroundSize, groundHeight, -halfGroundSize);
-    glm::vec3 p4 = glm::vec3(-halfGroundSize, groundHeight, -halfGroundSize);
-    Plane* plane = new Plane(p1, p2, p3, p4, planeColor);
-    objects.push_back(plane);
+    float terrainRelief = 2.0f;
+    
+    glm::vec3 groundColor = glm::vec3(0.1f, 0.1f, 0.1f);
+    terrain = NULL;
+    if (terrainFile) {
+        terrain = Terrain::load(terrainFile, halfGroundSize, groundHeight, terrainRelief, groundColor);
+    }
+    if (!terrain) { // flat ground
+        terrain = new Terrain(halfGroundSize, groundHeight, 2, groundColor);
+    }
+    objects.push_back(terrain);
+    windField = new WindField();
     
-    setScene(1);
+    if (playFile) {
+        if (!startPlayback()) return false;
+    }
+    else if (!resumeCheckpoint || !restoreCheckpoint()) {
+        // start with the mesh if one was given, the curtain otherwise
+        if (objFile) setScene(4);
+        if (!cloth) setScene(1);
+    }
+    if (recordAtStart && !player) {
+        startRecording();
+    }
     
 	return true;
 }
 
 void Window::cleanUp()
 {
+    stopRecording();
+    stopPlayback();
+    Profiler::closeCSV();
+    
+    sceneLoader.cancel();
+    delete incoming;
+    incoming = NULL;
+    
 	// Deallcoate the objects.
     for (Object* obj : objects) {
-        delete obj;
+        if (!clothCache.contains(obj)) delete obj;
     }
+    clothCache.clear();
+    delete bannerSubspace;
+    delete windField;
+    delete hud;
 
 	// Delete the shader program.
 	glDeleteProgram(shaderProgram);
+	if (hudProgram) glDeleteProgram(hudProgram);
 }
 
 // for the Window
@@ -81,6 +176,11 @@ GLFWwindow* Window::createWindow(int width, int height)
 	// 4x antialiasing.
 	glfwWindowHint(GLFW_SAMPLES, 4);
 
+	// Headless runs only need the context, frames go to an offscreen framebuffer.
+	if (headlessFrames > 0 || goldenDir) {
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	}
+
 #ifdef __APPLE__ 
 	// Apple implements its own version of OpenGL and requires special treatments
 	// to make it uses modern OpenGL.
@@ -152,22 +252,83 @@ void Window::resizeCallback(GLFWwindow* window, int width, int height)
 // update and draw functions
 void Window::idleCallback()
 {
+	PROFILE_SCOPE(PHASE_IDLE);
+
 	// Perform any updates as necessary. 
 	cam->update();
     
+    // a scene built in the background is swapped in between frames
+    updateSceneLoading();
+    
+    // at a fixed physics rate, the steps due since the last frame; the next frame is drawn between the last two
+    unsigned int steps = 1;
+    float blend = 1.0f;
+    if (physicsRate > 0.0f) {
+        double now = glfwGetTime();
+        double elapsed = headlessFrames > 0 ? 1.0 / HEADLESS_FRAME_RATE : (lastIdleTime < 0.0 ? 0.0 : now - lastIdleTime);
+        lastIdleTime = now;
+        
+        double period = 1.0 / physicsRate;
+        stepLag += elapsed;
+        steps = (unsigned int) glm::min(floor(stepLag / period), (double) MAX_CATCHUP_STEPS);
+        stepLag = fmod(stepLag - steps * period, period); // a frame too slow to catch up drops the rest
+        blend = (float) (stepLag / period);
+    }
+    
+    // set before stepping, as a step keeps the state before it only when this frame draws between the two
     for (Object* obj : objects) {
-        obj->update();
+        obj->setBlend(blend);
     }
     
-    if (glm::length(moveSpeed) != 0) {
-        for (unsigned int i = 1; i < objects.size(); i++) {
-            objects[i]->translate(moveSpeed);
+    for (unsigned int step = 0; step < steps; step++) {
+        for (Object* obj : objects) {
+            if (player && obj == cloth) continue; // the cache drives the cloth
+            obj->update();
+        }
+        
+        if (player && !playPaused) {
+            seekPlayback(playFrame + 1);
+        }
+        
+        if (recorder) {
+            // caches keep the build order, however the particles are laid out in memory
+            cloth->getOriginalPositions(recordPositions);
+            recorder->record(recordPositions);
+        }
+        
+        if (glm::length(moveSpeed) != 0) {
+            for (unsigned int i = 1; i < objects.size(); i++) {
+                objects[i]->translate(moveSpeed);
+            }
         }
     }
 }
 
 void Window::displayCallback(GLFWwindow* window)
 {	
+	{
+		PROFILE_SCOPE(PHASE_DISPLAY);
+		renderScene();
+
+		if (hud && showHud) {
+			hud->draw();
+		}
+	}
+
+	// Show the numbers in the title twice a second.
+	if (hud && showHud && Profiler::getFrameCount() % 30 == 0) {
+		string title = string(windowTitle) + " | " + hud->getSummary();
+		glfwSetWindowTitle(window, title.c_str());
+	}
+
+	// Gets events, including input such as keyboard and mouse or window resizing.
+	glfwPollEvents();
+	// Swap buffers.
+	glfwSwapBuffers(window);
+}
+
+void Window::renderScene()
+{
 	// Clear the color and depth buffers.
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);	
 
@@ -175,11 +336,128 @@ void Window::displayCallback(GLFWwindow* window)
     for (Object* obj : objects) {
         obj->draw(cam->getViewProjectMtx(), Window::shaderProgram);
     }
+}
 
-	// Gets events, including input such as keyboard and mouse or window resizing.
-	glfwPollEvents();
-	// Swap buffers.
-	glfwSwapBuffers(window);
+bool Window::renderHeadless()
+{
+	Offscreen offscreen(width, height, outputPrefix);
+	if (!offscreen.isComplete()) {
+		std::cerr << "Failed to create the offscreen framebuffer" << std::endl;
+		return false;
+	}
+
+	// Readback of frame i overlaps rendering and simulating the next frames.
+	for (unsigned int i = 0; i < headlessFrames; i++) {
+		{
+			PROFILE_SCOPE(PHASE_FRAME);
+
+			offscreen.begin();
+			{
+				PROFILE_SCOPE(PHASE_DISPLAY);
+				renderScene();
+			}
+			offscreen.end();
+
+			idleCallback();
+		}
+		// after the frame scope has added its time
+		Profiler::endFrame();
+	}
+	offscreen.finish();
+
+	std::cout << "Wrote " << offscreen.getFramesWritten() << " frames to " << outputPrefix << "*.ppm" << std::endl;
+	return true;
+}
+
+bool Window::runGolden()
+{
+	// the same build has to give the same result on any number of threads
+	Parallel::setDeterministic(true);
+
+	bool passed = true;
+	for (int sceneNum = 1; sceneNum <= GOLDEN_SCENES; sceneNum++) {
+		setScene(sceneNum);
+		for (unsigned int step = 0; step < goldenSteps; step++) {
+			cloth->update();
+		}
+
+		string path = string(goldenDir) + "/scene" + std::to_string(sceneNum) + ".ckpt";
+		if (goldenRecord) {
+			if (!Checkpoint::save(cloth, path.c_str())) return false;
+			std::cout << "Recorded scene " << sceneNum << " after " << goldenSteps << " steps to " << path << std::endl;
+			continue;
+		}
+
+		// no states are shipped, they only hold for the build that recorded them
+		Cloth* golden = Checkpoint::load(path.c_str());
+		if (!golden) {
+			std::cerr << "No usable golden state for scene " << sceneNum << " at " << path
+				<< ", record the states once with --golden-record " << goldenDir << " on a build known to be good" << std::endl;
+			return false;
+		}
+
+		const vector<glm::vec3>& expected = golden->getPositions();
+		const vector<glm::vec3>& actual = cloth->getPositions();
+		if (expected.size() != actual.size()) {
+			std::cerr << "Golden state " << path << " has " << expected.size() << " particles, scene "
+				<< sceneNum << " has " << actual.size() << std::endl;
+			delete golden;
+			passed = false;
+			continue;
+		}
+
+		// every particle is held to the tolerance, not just the average
+		float maxError = 0.0f;
+		unsigned int worst = 0;
+		unsigned int failures = 0;
+		for (unsigned int i = 0; i < actual.size(); i++) {
+			float error = glm::length(actual[i] - expected[i]);
+			if (error > goldenTolerance) failures++;
+			if (error > maxError) {
+				maxError = error;
+				worst = i;
+			}
+		}
+		std::cout << "Scene " << sceneNum << ": max error " << maxError << " at particle " << worst
+			<< ", " << failures << " particles over " << goldenTolerance
+			<< ", kinetic energy " << cloth->getKineticEnergy() << " (golden " << golden->getKineticEnergy() << ")"
+			<< (failures ? " FAILED" : " ok") << std::endl;
+		passed = passed && failures == 0;
+		delete golden;
+	}
+	return goldenRecord || (checkTiled() && passed);
+}
+
+bool Window::checkTiled()
+{
+	// the shipped scenes fit in one tile, so the halos between tiles are checked on a larger cloth;
+	// its particles weigh as much as those of the 50x50 scene 1, and the strain limit is on as it runs between the tile passes
+	float mass = (float) (TILED_CHECK_SIZE * TILED_CHECK_SIZE) / (50 * 50);
+	Cloth* untiled = new Cloth(TILED_CHECK_SIZE, TILED_CHECK_SIZE, 0.06f, mass, glm::vec3(1.0f), true);
+	Cloth* tiled = new Cloth(TILED_CHECK_SIZE, TILED_CHECK_SIZE, 0.06f, mass, glm::vec3(1.0f), true);
+	for (Cloth* c : {untiled, tiled}) {
+		c->setFixedRow(0);
+		c->setWind(glm::vec3(1.2f, 0.0f, 1.0f));
+		c->setStrainLimit(0.01f);
+	}
+	tiled->setTiled(true);
+	for (unsigned int step = 0; step < goldenSteps; step++) {
+		untiled->update();
+		tiled->update();
+	}
+
+	// tiling reorders no arithmetic, so the two match exactly
+	float maxError = 0.0f;
+	const vector<glm::vec3>& expected = untiled->getPositions();
+	const vector<glm::vec3>& actual = tiled->getPositions();
+	for (unsigned int i = 0; i < actual.size(); i++) {
+		maxError = glm::max(maxError, glm::length(actual[i] - expected[i]));
+	}
+	std::cout << "Tiled " << TILED_CHECK_SIZE << "x" << TILED_CHECK_SIZE << ": max difference to untiled " << maxError
+		<< (maxError > 0.0f ? " FAILED" : " ok") << std::endl;
+	delete untiled;
+	delete tiled;
+	return maxError == 0.0f;
 }
 
 // helper to reset the camera
@@ -252,16 +530,94 @@ void Window::keyCallback(GLFWwindow* window, int key, int scancode, int action,
                 cloth->setWind(glm::vec3(0.0f));
                 break;
             }
+            case GLFW_KEY_T: {
+                turbulentWind = !turbulentWind;
+                cloth->setWindField(turbulentWind ? windField : NULL);
+                std::cout << "Turbulent wind " << (turbulentWind ? "on" : "off") << std::endl;
+                break;
+            }
+            case GLFW_KEY_C: {
+                if (Checkpoint::save(cloth, checkpointFile)) {
+                    std::cout << "Saved checkpoint to " << checkpointFile << std::endl;
+                }
+                break;
+            }
+            case GLFW_KEY_V: {
+                restoreCheckpoint();
+                break;
+            }
+            case GLFW_KEY_H: {
+                showHud = !showHud;
+                if (!showHud) glfwSetWindowTitle(window, windowTitle);
+                break;
+            }
+            case GLFW_KEY_J: {
+                if (Tracer::isEnabled() && Tracer::write(traceFile)) {
+                    std::cout << "Wrote trace to " << traceFile << std::endl;
+                }
+                break;
+            }
+            case GLFW_KEY_P: {
+                playPaused = !playPaused;
+                break;
+            }
+            case GLFW_KEY_COMMA: {
+                if (player) seekPlayback((int) playFrame - 1);
+                break;
+            }
+            case GLFW_KEY_PERIOD: {
+                if (player) seekPlayback(playFrame + 1);
+                break;
+            }
+            case GLFW_KEY_PAGE_UP: {
+                if (player) seekPlayback((int) playFrame - 60);
+                break;
+            }
+            case GLFW_KEY_PAGE_DOWN: {
+                if (player) seekPlayback(playFrame + 60);
+                break;
+            }
+            case GLFW_KEY_HOME: {
+                if (player) seekPlayback(0);
+                break;
+            }
+            case GLFW_KEY_END: {
+                if (player) seekPlayback(player->getFrameCount() - 1);
+                break;
+            }
+            case GLFW_KEY_R: {
+                if (player) break;
+                if (recorder) {
+                    stopRecording();
+                }
+                else {
+                    startRecording();
+                }
+                break;
+            }
             case GLFW_KEY_1: {
-                setScene(1);
+                stopPlayback();
+                requestScene(1);
                 break;
             }
             case GLFW_KEY_2: {
-                setScene(2);
+                stopPlayback();
+                requestScene(2);
                 break;
             }
             case GLFW_KEY_3: {
-                setScene(3);
+                stopPlayback();
+                requestScene(3);
+                break;
+            }
+            case GLFW_KEY_4: {
+                stopPlayback();
+                requestScene(4);
+                break;
+            }
+            case GLFW_KEY_5: {
+                stopPlayback();
+                requestScene(5);
                 break;
             }
             default: {
@@ -304,64 +660,162 @@ void Window::cursorCallback(GLFWwindow* window, double currX, double currY) {
 	}
 }
 
-void Window::setScene(int sceneNum) {
+// shape of the cloth of each scene, scene 4 is the mesh given with --obj
+struct SceneCloth {
+    unsigned int height;
+    unsigned int width;
+    glm::vec3 color;
+    ClothLayout layout;
+};
+
+static const SceneCloth sceneCloths[] = {
+    {50, 50, glm::vec3(1.0f, 0.95f, 0.1f), LAYOUT_VERTICAL},        // scene 1: curtain
+    {50, 60, glm::vec3(0.95f, 0.08f, 0.0f), LAYOUT_VERTICAL},       // scene 2: flag
+    {40, 50, glm::vec3(0.81f, 0.98f, 0.53f), LAYOUT_HORIZONTAL},    // scene 3: parachute
+    {0, 0, glm::vec3(0.2f, 0.45f, 0.9f), LAYOUT_MESH},              // scene 4: OBJ mesh
+    {24, 16, glm::vec3(0.55f, 0.1f, 0.6f), LAYOUT_VERTICAL}         // scene 5: banner
+};
+
+// wind of the banners of scene 5, around which each draws its own gusts
+static const glm::vec3 bannerWind = glm::vec3(2.5f, 0.0f, 1.5f);
+static const glm::vec3 bannerGusts = glm::vec3(1.5f, 0.3f, 1.5f);
+
+void Window::requestScene(int sceneNum) {
+    if (sceneNum < 1 || sceneNum > SCENE_COUNT) return;
+    wantedScene = sceneNum;
+    
+    // scenes seen before are only a reset away
+    Cloth* reused = cachedCloth(sceneNum);
+    if (reused) {
+        setScene(sceneNum, reused);
+        return;
+    }
+    if (sceneLoader.isBusy() || incoming) return; // started once the build in flight is done
+    
+    sceneLoader.start(sceneNum, [sceneNum] { return buildCloth(sceneNum); });
+    std::cout << "Building scene " << sceneNum << " in the background" << std::endl;
+}
+
+void Window::updateSceneLoading() {
+    if (!incoming) {
+        if (!sceneLoader.isReady()) return;
+        
+        incomingScene = sceneLoader.getScene();
+        incoming = sceneLoader.take();
+        if (!incoming) {
+            std::cerr << "Scene 4 needs a mesh, start with --obj <file>" << std::endl;
+            if (wantedScene == incomingScene) wantedScene = scene;
+        }
+    }
+    
+    if (incoming) {
+        // the old scene keeps running until the whole cloth is on the GPU
+        if (!incoming->uploadBuffers(SCENE_UPLOAD_BUDGET)) return;
+        
+        Cloth* ready = incoming;
+        incoming = NULL;
+        if (incomingScene == wantedScene) {
+            setScene(incomingScene, ready);
+        }
+        else if (!storeCloth(incomingScene, ready)) { // superseded while it was built, kept for later if it can be
+            delete ready;
+        }
+    }
+    
+    // a scene asked for while the last one was built
+    if (wantedScene != scene) {
+        requestScene(wantedScene);
+    }
+}
+
+// a remeshed cloth keeps its refined triangles when it is reset, so it is built again instead of cached;
+// only mesh cloths are remeshed, grid cloths keep their rows
+static bool remeshed(const SceneCloth& shape) {
+    return Window::remeshing && shape.layout == LAYOUT_MESH;
+}
+
+Cloth* Window::cachedCloth(int sceneNum) {
+    const SceneCloth& shape = sceneCloths[sceneNum - 1];
+    if (remeshed(shape)) return NULL;
+    return clothCache.acquire(shape.width, shape.height, shape.layout, shape.layout != LAYOUT_MESH && !springObjects);
+}
+
+bool Window::storeCloth(int sceneNum, Cloth* built) {
+    const SceneCloth& shape = sceneCloths[sceneNum - 1];
+    if (remeshed(shape)) return false;
+    clothCache.store(shape.width, shape.height, shape.layout, shape.layout != LAYOUT_MESH && !springObjects, built);
+    return true;
+}
+
+Cloth* Window::buildCloth(int sceneNum) {
+    if (sceneNum < 1 || sceneNum > SCENE_COUNT) return NULL;
+    
+    const SceneCloth& shape = sceneCloths[sceneNum - 1];
+    Cloth* built;
+    if (shape.layout == LAYOUT_MESH) {
+        built = objFile ? ObjLoader::load(objFile, 3.0f, 1.0f, shape.color) : NULL;
+        if (!built) return NULL;
+        std::cout << "Loaded " << built->getPositions().size() << " particles from " << objFile << std::endl;
+    }
+    else {
+        built = new Cloth(shape.height, shape.width, 0.06f, 1.0f, shape.color, shape.layout == LAYOUT_VERTICAL, !springObjects);
+    }
+    
+    float span = built->getMeanEdgeSpan();
+    if (built->reorder(reorderMethod)) {
+        std::cout << "Reordered particles, mean spring span " << span << " -> " << built->getMeanEdgeSpan() << std::endl;
+    }
+    return built;
+}
+
+void Window::setScene(int sceneNum, Cloth* prepared) {
+    if (sceneNum < 1 || sceneNum > SCENE_COUNT) return;
+    
+    // reuse a cached cloth or build one here, unless the loader already did
+    Cloth* next = prepared ? prepared : cachedCloth(sceneNum);
+    if (!next) {
+        next = buildCloth(sceneNum);
+        if (!next) {
+            std::cerr << "Scene 4 needs a mesh, start with --obj <file>" << std::endl;
+            return;
+        }
+    }
+    if (!clothCache.contains(next)) {
+        storeCloth(sceneNum, next);
+    }
+    
+    // a recording covers a single cloth
+    stopRecording();
+    resetCamera();
+    moveSpeed = glm::vec3(0.0f);
+    clearScene();
+    
+    cloth = next;
+    cloth->setTerrain(terrain);
+    objects.push_back(cloth);
+    
     switch (sceneNum) {
         case 1: { // scene 1: vertical cloth with fixed first row (curtain)
-            resetCamera();
-            moveSpeed = glm::vec3(0.0f);
-            
-            while (objects.size() > 1) { // delete non-plane object
-                delete objects.back();
-                objects.pop_back();
-            }
-            
-            glm::vec3 clothColor = glm::vec3(1.0f, 0.95f, 0.1f);
-            cloth = new Cloth(50, 50, 0.06f, 1.0f, clothColor, true);
             cloth->setFixedRow(0);
             cloth->setWind(glm::vec3(1.2f, 0.0f, 1.0f)); // initial wind speed
-            cloth->setGroundHeight(groundHeight);
-            objects.push_back(cloth);
             break;
         }
         case 2: { // scene 2: vertical cloth with 3 fixed points (flag)
-            resetCamera();
-            moveSpeed = glm::vec3(0.0f);
-            
-            while (objects.size() > 1) { // delete non-plane object
-                delete objects.back();
-                objects.pop_back();
-            }
-            glm::vec3 color = glm::vec3(0.95f, 0.08f, 0.0f);
-            cloth = new Cloth(50, 60, 0.06f, 1.0f, color, true);
             cloth->setFixedPoint(0, 0);
             cloth->setFixedPoint(24, 0);
             cloth->setFixedPoint(49, 0);
             cloth->setWind(glm::vec3(4.5f, 0.0f, 1.2f)); // initial wind speed
-            cloth->setGroundHeight(groundHeight);
-            objects.push_back(cloth);
             break;
         }
         case 3: { // scene 3: horizontal cloth with fixed corners (parachute)
-            resetCamera();
-            moveSpeed = glm::vec3(0.0f);
-            
-            while (objects.size() > 1) { // delete non-plane object
-                delete objects.back();
-                objects.pop_back();
-            }
-            
-            unsigned int height = 40;
-            unsigned int width = 50;
+            unsigned int height = sceneCloths[2].height;
+            unsigned int width = sceneCloths[2].width;
             
-            glm::vec3 clothColor = glm::vec3(0.81f, 0.98f, 0.53f);
-            cloth = new Cloth(height, width, 0.06f, 1.0f, clothColor, false);
             glm::vec3 a0 = cloth->setFixedPoint(0, 0);
             glm::vec3 b0 = cloth->setFixedPoint(0, width - 1);
             glm::vec3 c0 = cloth->setFixedPoint(height - 1, width - 1);
             glm::vec3 d0 = cloth->setFixedPoint(height - 1, 0);
             cloth->setWind(glm::vec3(0.0f, 5.0f, -0.2f));
-            cloth->setGroundHeight(groundHeight);
-            objects.push_back(cloth);
             
             glm::vec3 cubeColor = glm::vec3(0.28f, 0.14f, 0.04f);
             glm::vec3 cubeMin = glm::vec3(-0.25f, -1.5f, -0.25f);
@@ -384,8 +838,146 @@ void Window::setScene(int sceneNum) {
             
             break;
         }
-        default: {
+        case 4: { // scene 4: garment or sail loaded from an OBJ file, pinned along its top
+            float top = -FLT_MAX;
+            for (const glm::vec3& p : cloth->getPositions()) {
+                top = glm::max(top, p.y);
+            }
+            cloth->setFixedAbove(top - 0.05f);
+            cloth->setWind(glm::vec3(1.2f, 0.0f, 1.0f));
+            break;
+        }
+        case 5: { // scene 5: banner in front of a field of banners run in its subspace
+            cloth->setFixedRow(0);
+            cloth->setWind(bannerWind);
+            
+            // the background banners follow a run of a banner like the one in front, under the same kind of wind;
+            // training steps a cloth, which uses the thread pool and the profiler, so it runs here on the main thread
+            if (!bannerSubspace) {
+                const SceneCloth& shape = sceneCloths[4];
+                Cloth* trainer = new Cloth(shape.height, shape.width, 0.06f, 1.0f, shape.color, true, true);
+                trainer->setFixedRow(0);
+                Gusts gusts(bannerWind, bannerGusts, 1);
+                bannerSubspace = Subspace::train(trainer, gusts, BANNER_WARMUP, BANNER_FRAMES);
+                delete trainer;
+                std::cout << "Trained " << bannerSubspace->getModes() << " banner modes, "
+                    << bannerSubspace->getCapturedVariance() * 100.0f << "% of the motion" << std::endl;
+            }
+            
+            for (unsigned int i = 0; i < BANNER_COUNT; i++) {
+                // rows of 10 going back from behind the banner, each row a bit further apart
+                float row = (float) (i / 10);
+                glm::vec3 position = glm::vec3(((float) (i % 10) - 4.5f) * (2.0f + 0.3f * row), 0.0f, -4.0f - 1.8f * row);
+                float shade = 0.6f + 0.4f * (float) ((i * 7) % 10) / 9.0f;
+                glm::vec3 color = glm::vec3(shade * 0.55f, 0.1f + 0.5f * (float) (i % 3) / 2.0f, shade * 0.6f);
+                objects.push_back(new SubspaceCloth(bannerSubspace, bannerWind, bannerGusts, color, position, i + 2));
+            }
             break;
         }
     }
+    scene = sceneNum;
+    wantedScene = sceneNum;
+    configureCloth();
+}
+
+void Window::clearScene() {
+    while (objects.size() > 1) { // delete non-ground object, cached cloths stay alive
+        if (!clothCache.contains(objects.back())) {
+            delete objects.back();
+        }
+        objects.pop_back();
+    }
+}
+
+void Window::configureCloth() {
+    cloth->setTiled(tiledUpdate || sleepTiles || multirateTiles);
+    cloth->setSleeping(sleepTiles);
+    cloth->setMultirate(multirateTiles);
+    if (multirateTiles && cloth->getTileCount() <= 1) {
+        // a single tile holds the pins, and pinned tiles keep TIME_STEP
+        std::cout << "Multirate stepping has no effect on this cloth, it is not a grid of several tiles" << std::endl;
+    }
+    cloth->setWindField(turbulentWind ? windField : NULL);
+    cloth->setStrainLimit(strainLimit);
+    cloth->setRemeshing(remeshing);
+    
+    float span = cloth->getMeanEdgeSpan();
+    if (cloth->reorder(reorderMethod)) {
+        std::cout << "Reordered particles, mean spring span " << span << " -> " << cloth->getMeanEdgeSpan() << std::endl;
+    }
+    cloth->setProjective(projectiveSolve);
+}
+
+bool Window::restoreCheckpoint() {
+    Cloth* restored = Checkpoint::load(checkpointFile);
+    if (!restored) return false;
+    
+    stopPlayback();
+    stopRecording();
+    scene = 0;
+    wantedScene = 0;
+    moveSpeed = glm::vec3(0.0f);
+    clearScene();
+    
+    cloth = restored;
+    cloth->setTerrain(terrain);
+    configureCloth();
+    objects.push_back(cloth);
+    return true;
+}
+
+void Window::startRecording() {
+    // a cache holds the same particles in every frame
+    if (cloth->isRemeshing()) {
+        std::cerr << "Cannot record a cloth that is remeshed" << std::endl;
+        return;
+    }
+    recorder = Recorder::open(cacheFile, (unsigned int) cloth->getPositions().size(), scene, NUM_SAMPLE * TIME_STEP);
+    if (recorder) {
+        std::cout << "Recording to " << cacheFile << std::endl;
+    }
+}
+
+void Window::stopRecording() {
+    if (!recorder) return;
+    
+    std::cout << "Recorded " << recorder->getFrameCount() << " frames to " << cacheFile
+        << " (" << recorder->getStalls() << " stalls)" << std::endl;
+    delete recorder;
+    recorder = NULL;
+}
+
+bool Window::startPlayback() {
+    player = Player::open(playFile);
+    if (!player) return false;
+    
+    // rebuild the recorded scene so the cache feeds a cloth with matching buffers
+    setScene(player->getScene());
+    if (!cloth || cloth->getPositions().size() != player->getParticleCount()) {
+        std::cerr << "Cache " << playFile << " does not match scene " << player->getScene() << std::endl;
+        stopPlayback();
+        return false;
+    }
+    
+    std::cout << "Playing " << player->getFrameCount() << " frames from " << playFile << std::endl;
+    playPaused = false;
+    seekPlayback(0);
+    return true;
+}
+
+void Window::stopPlayback() {
+    delete player;
+    player = NULL;
+}
+
+void Window::seekPlayback(int frame) {
+    int numFrames = (int) player->getFrameCount();
+    if (numFrames == 0) return;
+    
+    // wrap around so playback loops and stepping back from the first frame goes to the last
+    playFrame = (unsigned int) (((frame % numFrames) + numFrames) % numFrames);
+    playPositions.resize(player->getParticleCount());
+    if (player->getFrame(playFrame, playPositions.data())) {
+        cloth->showFrame(playPositions.data());
+    }
 }
@@ -5,9 +5,30 @@
 #include "Shader.hpp"
 #include "Camera.hpp"
 #include "Cloth.hpp"
-#include "Plane.hpp"
+#include "Terrain.hpp"
 #include "Cube.hpp"
 #include "Line.hpp"
+#include "Checkpoint.hpp"
+#include "Recorder.hpp"
+#include "Player.hpp"
+#include "Offscreen.hpp"
+#include "Hud.hpp"
+#include "Parallel.hpp"
+#include "ObjLoader.hpp"
+#include "ClothCache.hpp"
+#include "SceneLoader.hpp"
+#include "SubspaceCloth.hpp"
+
+#include <float.h>
+
+#define GOLDEN_SCENES   3   // scenes covered by the golden states
+#define TILED_CHECK_SIZE 160    // side of the grid cloth the tiled update is checked on, several tiles wide
+#define SCENE_COUNT     5
+#define BANNER_COUNT    200     // background banners of scene 5, stepped in the subspace
+#define BANNER_WARMUP   200     // frames the training banner runs before it is recorded
+#define BANNER_FRAMES   1200    // frames of the training banner the subspace is fitted to
+#define MAX_CATCHUP_STEPS   8   // steps a frame takes at most at a fixed physics rate, time past them is dropped
+#define HEADLESS_FRAME_RATE 60  // frames per second of wall time headless frames stand for at a fixed physics rate
 
 class Window {
 public:
@@ -19,9 +40,89 @@ public:
 	// Objects to render
     static vector<Object*> objects;
     static Cloth* cloth;
+    static Terrain* terrain;
+
+    // optional 16-bit heightfield (PGM or raw) used as the ground
+    static const char* terrainFile;
+
+    // snapshot written and restored by the checkpoint keys, or resumed at start
+    static const char* checkpointFile;
+    static bool resumeCheckpoint;
+
+    // frame cache written while recording
+    static const char* cacheFile;
+    static bool recordAtStart;
+    static Recorder* recorder;
+    static int scene;
+
+    // cache played back instead of simulating
+    static const char* playFile;
+    static Player* player;
+    static unsigned int playFrame;
+    static bool playPaused;
+
+    // render this many frames offscreen to an image sequence instead of opening a window
+    static unsigned int headlessFrames;
+    static const char* outputPrefix;
+
+    // run every scene for a fixed number of steps and record or check its golden state
+    static const char* goldenDir;
+    static bool goldenRecord;
+    static unsigned int goldenSteps;
+    static float goldenTolerance;
+
+    // build the scenes with one SpringDamper per edge instead of the grid stencil
+    static bool springObjects;
+
+    // update grid cloths tile by tile with all substeps per tile
+    static bool tiledUpdate;
+
+    // stop simulating tiles that have settled, implies the tiled update
+    static bool sleepTiles;
+
+    // experimental: step calm tiles of grid cloths with longer steps than violent ones, implies the tiled update
+    static bool multirateTiles;
+
+    // largest stretch of a spring as a fraction of its rest length, 0 leaves springs free
+    static float strainLimit;
+
+    // baked turbulence shared by every cloth, blown around the mean wind while turbulentWind is on
+    static WindField* windField;
+    static bool turbulentWind;
+
+    // integrate cloths implicitly with Projective Dynamics instead of explicit substeps
+    static bool projectiveSolve;
+
+    // refine mesh cloths where they fold and coarsen them where they lie flat
+    static bool remeshing;
+
+    // steps per second of wall time, drawn between the last two; 0 takes one step per frame drawn
+    static float physicsRate;
+
+    // permute the particles of cloths without the grid stencil for locality
+    static ReorderMethod reorderMethod;
+
+    // triangle mesh simulated in scene 4
+    static const char* objFile;
+
+    // cloths of earlier scenes, reused when a scene is entered again
+    static ClothCache clothCache;
+
+    // builds scenes that are not cached without stopping the current one
+    static SceneLoader sceneLoader;
+
+    // reduced model of the banner of scene 5, trained once when the scene is first built
+    static Subspace* bannerSubspace;
 
 	// Shader Program 
 	static GLuint shaderProgram;
+	static GLuint hudProgram;
+
+	// profiler overlay
+	static Hud* hud;
+	static bool showHud;
+	static const char* profileFile;
+	static const char* traceFile;
 
 	// Act as Constructors and desctructors 
 	static bool initializeProgram();
@@ -35,6 +136,10 @@ public:
 	// update and draw functions
 	static void idleCallback();
 	static void displayCallback(GLFWwindow*);
+	static void renderScene();
+	static bool renderHeadless();
+	static bool runGolden();
+	static bool checkTiled();
 
 	// helper to reset the camera
 	static void resetCamera();
@@ -45,6 +150,23 @@ public:
 	static void cursorCallback(GLFWwindow* window, double currX, double currY);
     
 private:
-    static void setScene(int sceneNum);
+    // switch right away, building the cloth here unless it is cached or prepared
+    static void setScene(int sceneNum, Cloth* prepared = NULL);
+    // switch without stalling: a cloth that is not cached is built in the background
+    static void requestScene(int sceneNum);
+    static void updateSceneLoading();
+    static Cloth* cachedCloth(int sceneNum);
+    // false for a cloth that is not cached, which stays with the caller
+    static bool storeCloth(int sceneNum, Cloth* built);
+    // no OpenGL calls, safe on the loader thread
+    static Cloth* buildCloth(int sceneNum);
+    static void clearScene();
+    static void configureCloth();
+    static bool restoreCheckpoint();
+    static void startRecording();
+    static void stopRecording();
+    static bool startPlayback();
+    static void stopPlayback();
+    static void seekPlayback(int frame);
 };
 #endif
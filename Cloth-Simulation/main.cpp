@@ -50,12 +50,154 @@ void print_versions()
 #endif
 }
 
+bool writeTraceAtExit = false;
 
+void parse_arguments(int argc, char** argv)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		// Use a 16-bit heightfield as the ground.
+		if (arg == "--terrain" && i + 1 < argc)
+		{
+			Window::terrainFile = argv[++i];
+		}
+		// Start from a saved checkpoint instead of scene 1.
+		else if (arg == "--resume" && i + 1 < argc)
+		{
+			Window::checkpointFile = argv[++i];
+			Window::resumeCheckpoint = true;
+		}
+		// Record every frame into a cache from the start.
+		else if (arg == "--record" && i + 1 < argc)
+		{
+			Window::cacheFile = argv[++i];
+			Window::recordAtStart = true;
+		}
+		// Play back a recorded cache instead of simulating.
+		else if (arg == "--play" && i + 1 < argc)
+		{
+			Window::playFile = argv[++i];
+		}
+		// Render frames offscreen into an image sequence and exit.
+		else if (arg == "--headless" && i + 1 < argc)
+		{
+			Window::headlessFrames = (unsigned int) std::max(0, atoi(argv[++i]));
+		}
+		else if (arg == "--output" && i + 1 < argc)
+		{
+			Window::outputPrefix = argv[++i];
+		}
+		// Per-frame phase timings of profiled builds.
+		else if (arg == "--profile-csv" && i + 1 < argc)
+		{
+			Window::profileFile = argv[++i];
+		}
+		// Chrome trace JSON written at exit by traced builds.
+		else if (arg == "--trace" && i + 1 < argc)
+		{
+			Window::traceFile = argv[++i];
+			writeTraceAtExit = true;
+		}
+		// Where the checkpoint keys save and restore.
+		else if (arg == "--checkpoint" && i + 1 < argc)
+		{
+			Window::checkpointFile = argv[++i];
+		}
+		// Record or check the golden state of each scene and exit.
+		else if ((arg == "--golden-record" || arg == "--golden-check") && i + 1 < argc)
+		{
+			Window::goldenRecord = arg == "--golden-record";
+			Window::goldenDir = argv[++i];
+		}
+		else if (arg == "--golden-steps" && i + 1 < argc)
+		{
+			Window::goldenSteps = (unsigned int) std::max(0, atoi(argv[++i]));
+		}
+		else if (arg == "--golden-tolerance" && i + 1 < argc)
+		{
+			Window::goldenTolerance = (float) atof(argv[++i]);
+		}
+		// Reductions in a fixed order, independent of the thread count.
+		else if (arg == "--deterministic")
+		{
+			Parallel::setDeterministic(true);
+		}
+		else if (arg == "--threads" && i + 1 < argc)
+		{
+			Parallel::setThreadCount((unsigned int) std::max(1, atoi(argv[++i])));
+		}
+		// Simulate grid cloths with per-edge spring objects, e.g. to compare against the stencil.
+		else if (arg == "--spring-objects")
+		{
+			Window::springObjects = true;
+		}
+		// Run all substeps on one cache-sized tile of the cloth at a time.
+		else if (arg == "--tiled")
+		{
+			Window::tiledUpdate = true;
+		}
+		// Let settled tiles of grid cloths sleep until they are disturbed, runs the tiled update.
+		else if (arg == "--sleep")
+		{
+			Window::sleepTiles = true;
+		}
+		// Experimental: step calm tiles of grid cloths with longer steps than tiles near pins, contact or high strain.
+		// It saves nothing on the shipped scenes, see the README.
+		else if (arg == "--experimental-multirate")
+		{
+			Window::multirateTiles = true;
+		}
+		// Limit the stretch of every structural and shear spring to a percentage of its rest length.
+		else if (arg == "--strain-limit" && i + 1 < argc)
+		{
+			Window::strainLimit = std::max(0.0f, (float) atof(argv[++i]) / 100.0f);
+		}
+		// Blow turbulent wind with gusts around the mean wind instead of the same wind everywhere.
+		else if (arg == "--turbulence")
+		{
+			Window::turbulentWind = true;
+		}
+		// Integrate with Projective Dynamics, one implicit step per frame with a prefactored system.
+		else if (arg == "--projective")
+		{
+			Window::projectiveSolve = true;
+		}
+		// Split and collapse edges of mesh cloths as they fold and flatten.
+		else if (arg == "--remesh")
+		{
+			Window::remeshing = true;
+		}
+		// Step at a fixed rate of wall time and draw between the last two steps.
+		else if (arg == "--physics-rate" && i + 1 < argc)
+		{
+			Window::physicsRate = std::max(0.0f, (float) atof(argv[++i]));
+		}
+		// Reorder particles of spring-object cloths along a Morton curve or by reverse Cuthill-McKee.
+		else if (arg == "--reorder" && i + 1 < argc)
+		{
+			Window::reorderMethod = Reorder::parse(argv[++i]);
+		}
+		// Triangle mesh for scene 4, which starts right away.
+		else if (arg == "--obj" && i + 1 < argc)
+		{
+			Window::objFile = argv[++i];
+		}
+		else
+		{
+			std::cerr << "Ignoring unknown argument " << arg << std::endl;
+		}
+	}
+}
 
 ////////////////////////////////////////////////////////////////////////////////
 
-int main(void)
+int main(int argc, char** argv)
 {
+	// Read command line options.
+	parse_arguments(argc, argv);
+	Tracer::setThreadName("main");
+
 	// Create the GLFW window.
 	GLFWwindow* window = Window::createWindow(800, 800);
 	if (!window) exit(EXIT_FAILURE);
@@ -72,23 +214,37 @@ int main(void)
 	// Initialize objects/pointers for rendering; exit if initialization fails.
 	if (!Window::initializeObjects()) exit(EXIT_FAILURE);
 	
+	// Render without a visible window.
+	bool headlessFailed = Window::headlessFrames > 0 && !Window::renderHeadless();
+	// Compare against the golden states without a visible window.
+	bool goldenFailed = Window::goldenDir && !Window::runGolden();
+
 	// Loop while GLFW window should stay open.
-	while (!glfwWindowShouldClose(window))
+	while (Window::headlessFrames == 0 && !Window::goldenDir && !glfwWindowShouldClose(window))
 	{
-		// Main render display callback. Rendering of objects is done here.
-		Window::displayCallback(window);
+		{
+			PROFILE_SCOPE(PHASE_FRAME);
+
+			// Main render display callback. Rendering of objects is done here.
+			Window::displayCallback(window);
+
+			// Idle callback. Updating objects, etc. can be done here.
+			Window::idleCallback();
+		}
 
-		// Idle callback. Updating objects, etc. can be done here.
-		Window::idleCallback();
+		// Close the frame for the profiler once the frame scope has added its time.
+		Profiler::endFrame();
 	}
 
 	Window::cleanUp();
+	// Dump the timeline after the recorder and player threads have finished.
+	if (writeTraceAtExit && Tracer::isEnabled()) Tracer::write(Window::traceFile);
 	// Destroy the window.
 	glfwDestroyWindow(window);
 	// Terminate GLFW.
 	glfwTerminate();
 
-	exit(EXIT_SUCCESS);
+	exit(headlessFailed || goldenFailed ? EXIT_FAILURE : EXIT_SUCCESS);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,11 @@
+#version 330 core
+
+// Flat colored overlay, no lighting.
+in vec3 fragColor;
+
+out vec4 outColor;
+
+void main()
+{
+	outColor = vec4(fragColor, 1);
+}
@@ -0,0 +1,15 @@
+#version 330 core
+// NOTE: Do NOT use any version older than 330! Bad things will happen!
+
+// Overlay vertices are already in normalized device coordinates.
+layout (location = 0) in vec2 position;
+layout (location = 1) in vec3 color;
+
+out vec3 fragColor;
+
+
+void main()
+{
+    gl_Position = vec4(position, 0.0, 1.0);
+    fragColor = color;
+}
@@ -3,10 +3,15 @@
 
 layout (location = 0) in vec3 position;
 layout (location = 1) in vec3 normal;
+// state before the last step, for objects that keep it
+layout (location = 2) in vec3 previousPosition;
+layout (location = 3) in vec3 previousNormal;
 
 // Uniform variables
 uniform mat4 viewProj;
 uniform mat4 model;
+// share of the way from the previous state to the current one, 1 draws the current state alone
+uniform float blend = 1.0;
 
 // Outputs of the vertex shader are the inputs of the same name of the fragment shader.
 // The default output, gl_Position, should be assigned something. 
@@ -15,9 +20,18 @@ out vec3 fragNormal;
 
 void main()
 {
+    // the previous streams are not read at all unless blending, they may hold nothing
+    vec3 p = position;
+    vec3 n = normal;
+    if (blend < 1.0) {
+        p = mix(previousPosition, position, blend);
+        // blended normals are made unit again
+        n = normalize(mix(previousNormal, normal, blend));
+    }
+
     // OpenGL maintains the D matrix so you only need to multiply by P, V (aka C inverse), and M
-    gl_Position = viewProj * model * vec4(position, 1.0);
+    gl_Position = viewProj * model * vec4(p, 1.0);
 
     // for shading
-	fragNormal = vec3(model * vec4(normal, 0));
+	fragNormal = vec3(model * vec4(n, 0));
 }
\ No newline at end of file